@@ -0,0 +1,323 @@
+#include "Assembler.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include "CompilerConfig.hpp"
+#include "SourceFile.hpp"
+
+std::string Assembler::typeMap(OperandType type) {
+    if (type == ACCUMULATOR)
+        return "accumulator";
+    if (type == REGISTER)
+        return "register";
+    if (type == LITERAL)
+        return "literal";
+    throw std::runtime_error("Unknown operand type!");
+}
+
+std::string Assembler::checkOperands(const CommandDescriptor* command,
+                                     std::span<const Operand> operands,
+                                     size_t& token) {
+    token = 0;
+    if (operands.size() != command->opcount)
+        return "Wrong number of arguments for " + std::string(command->name) +
+               "! " + std::to_string(operands.size()) + " provided, but " +
+               std::to_string(command->opcount) + " needed.";
+
+    for (size_t i = 0; i < command->opcount; i++) {
+        if ((operands[i].type & command->suitableOperandTypes[i]) == 0) {
+            token = i + 1;
+            return "Wrong argument " + std::to_string(i) + " type for " +
+                   std::string(command->name) +
+                   "! Provided: " + typeMap(operands[i].type) + ".";
+        }
+    }
+    if (!command->accepts(operands)) {
+        token = operands.size();
+        std::string combination;
+        for (size_t i = 0; i < operands.size(); i++)
+            combination += (i == 0 ? "" : " and ") + typeMap(operands[i].type);
+        return std::string(command->name) + " has no form for " + combination +
+               " operands!";
+    }
+    return {};
+}
+
+std::string Assembler::describeLine(size_t lineNumber) const {
+    LineMap::Location location{&sourceName, lineNumber};
+    if (lineMap != nullptr && lineMap->locate(lineNumber).file != nullptr)
+        location = lineMap->locate(lineNumber);
+    if (*location.file == sourceName)
+        return "line " + std::to_string(location.line);
+    return *location.file + ":" + std::to_string(location.line);
+}
+
+Assembler::Assembler(std::string sourceName, bool optimize)
+    : sourceName(sourceName), optimize(optimize), diagnostics(sourceName) {
+    if (optimize)
+        optimizer.emplace();
+}
+
+void Assembler::reset() {
+    image.clear();
+    program.clear();
+    symbols.clear();
+    fixups.clear();
+    exports.clear();
+    diagnostics.clear();
+    if (optimize)
+        optimizer.emplace();
+}
+
+bool Assembler::parseLine(const TokenList& tokens, ParsedLine& line) {
+    line.label = {};
+    line.command = nullptr;
+    line.operandCount = 0;
+    line.symbol = {};
+    auto fail = [&line](size_t token, std::string message) {
+        line.errorToken = token;
+        line.error = std::move(message);
+        return false;
+    };
+
+    size_t first = 0;
+    {
+        AssemblyStats::Timer timer(stats, AssemblyStats::PARSING);
+        if (tokens[0].text.ends_with(':')) {
+            std::string_view name = tokens[0].text;
+            name.remove_suffix(1);
+            if (!Operand::isSymbolName(name))
+                return fail(0, "Invalid label name: " + std::string(name) +
+                                   "! Labels must not read as A, a register "
+                                   "or a hex literal.");
+            line.label = name;
+            line.labelPosition = tokens[0].position;
+            first = 1;
+        }
+        if (tokens.size() <= first)
+            return true;
+        line.operandCount = tokens.size() - first - 1;
+        line.command = CompilerConfig::commands.findByName(tokens[first].text,
+                                                           line.operandCount);
+        if (line.command == nullptr)
+            return fail(first, "No such instruction: " +
+                                   std::string(tokens[first].text) + "!");
+        for (size_t i = 0; i < line.operandCount; i++)
+            if (const char* error = Operand::parse(tokens[first + 1 + i].text,
+                                                   line.operands[i]))
+                return fail(first + 1 + i, error);
+    }
+    {
+        AssemblyStats::Timer timer(stats, AssemblyStats::VALIDATING);
+        size_t token;
+        std::string error =
+            checkOperands(line.command, line.getOperands(), token);
+        if (!error.empty())
+            return fail(first + token, std::move(error));
+    }
+
+    // Labels are patched into the last byte of the encoding.
+    line.encoding = line.command->encode(line.getOperands());
+    for (size_t i = 0; i < line.operandCount; i++) {
+        if (line.operands[i].symbol.empty())
+            continue;
+        if (line.encoding.size < 2)
+            return fail(first + 1 + i,
+                        "Label " + std::string(line.operands[i].symbol) +
+                            " used where " + std::string(line.command->name) +
+                            " does not encode a literal byte!");
+        line.symbol = line.operands[i].symbol;
+        line.symbolPosition = tokens[first + 1 + i].position;
+    }
+    return true;
+}
+
+void Assembler::addExports(const TokenList& tokens, std::string_view line) {
+    if (tokens.size() == 1)
+        diagnostics.add(tokens[0].position, tokens[0].text,
+                        ".global needs at least one label!", line);
+    for (size_t i = 1; i < tokens.size(); i++) {
+        if (i == 8) {
+            diagnostics.add(tokens[7].position, tokens[7].text,
+                            "Too many labels for one .global line!", line);
+            break;
+        }
+        if (!Operand::isSymbolName(tokens[i].text))
+            diagnostics.add(tokens[i].position, tokens[i].text,
+                            "Invalid label name: " +
+                                std::string(tokens[i].text) + "!",
+                            line);
+        else
+            exports.push_back(
+                {0, symbols.intern(tokens[i].text), tokens[i].position});
+    }
+}
+
+void Assembler::translateLine(std::string_view line, size_t lineNumber) {
+    if (stats != nullptr)
+        stats->lines++;
+    {
+        AssemblyStats::Timer timer(stats, AssemblyStats::TOKENIZING);
+        Lexer::tokenize(line, lineNumber, tokens);
+    }
+    if (tokens.empty())
+        return;
+    if (line.ends_with('\r'))
+        line.remove_suffix(1);
+    if (tokens[0].text == ".global") {
+        addExports(tokens, line);
+        return;
+    }
+    // A bad instruction still defines its label, so the label's uses do
+    // not add errors of their own.
+    bool valid = parseLine(tokens, parsed);
+    if (!valid) {
+        const Token& token = tokens[parsed.errorToken];
+        diagnostics.add(token.position, token.text, std::move(parsed.error),
+                        line);
+    }
+    if (!parsed.label.empty()) {
+        size_t symbol = symbols.intern(parsed.label);
+        if (symbols[symbol].defined) {
+            diagnostics.add(parsed.labelPosition, tokens[0].text,
+                            "Label " + std::string(parsed.label) +
+                                " is already defined at " +
+                                describeLine(
+                                    symbols[symbol].definition.line) +
+                                "!",
+                            line);
+        } else
+            program.pushLabel(
+                symbols.define(parsed.label, 0, parsed.labelPosition));
+    }
+    if (!valid || parsed.command == nullptr)
+        return;
+    program.push(parsed.command, parsed.encoding, parsed.getOperands(),
+                 lineNumber);
+    if (!parsed.symbol.empty())
+        program.pushReference(symbols.intern(parsed.symbol),
+                              parsed.symbolPosition);
+}
+
+void Assembler::layout() {
+    if (lineTable != nullptr)
+        lineTable->clear();
+    auto placeLabel = [this](size_t label) {
+        symbols.setAddress(program.labelSymbol(label), image.size());
+        if (lineTable != nullptr)
+            lineTable->addLabel(
+                image.size(), symbols[program.labelSymbol(label)].name,
+                symbols[program.labelSymbol(label)].definition.line);
+    };
+    size_t label = 0;
+    size_t reference = 0;
+    for (size_t i = 0; i < program.size(); i++) {
+        for (; label < program.labelCount() &&
+               program.labelStatement(label) <= i;
+             label++)
+            placeLabel(label);
+        if (!program.live(i))
+            continue;
+        if (lineTable != nullptr)
+            lineTable->addInstruction(image.size(), program.encoding(i).size,
+                                      program.line(i));
+        write(program.encoding(i));
+        if (stats != nullptr)
+            stats->instructions[program.command(i)->type]++;
+        if (program.symbolic(i)) {
+            while (program.referenceStatement(reference) < i)
+                reference++;
+            fixups.push_back({image.size() - 1,
+                              program.referenceSymbol(reference),
+                              program.referencePosition(reference)});
+        }
+    }
+    for (; label < program.labelCount(); label++)
+        placeLabel(label);
+}
+
+void Assembler::resolveSymbols() {
+    for (const Fixup& fixup : fixups) {
+        const Symbol& symbol = symbols[fixup.symbol];
+        if (!symbol.defined && relocatable)
+            continue;
+        if (!symbol.defined)
+            diagnostics.add(fixup.position, symbol.name,
+                            "Undefined label: " + symbol.name + "!");
+        else if (symbol.address > 0xFF)
+            diagnostics.add(fixup.position, symbol.name,
+                            "Label " + symbol.name + " at address " +
+                                std::to_string(symbol.address) +
+                                " does not fit into 8 bits!");
+        else
+            image[fixup.offset] = symbol.address;
+    }
+    for (const Fixup& exported : exports)
+        if (!symbols[exported.symbol].defined)
+            diagnostics.add(exported.position, symbols[exported.symbol].name,
+                            "Exported label " + symbols[exported.symbol].name +
+                                " is not defined!");
+}
+
+ObjectFile Assembler::getObject() const {
+    ObjectFile object;
+    object.sections.push_back({"text", image});
+    object.symbols.resize(symbols.size());
+    for (size_t i = 0; i < symbols.size(); i++) {
+        object.symbols[i].name = symbols[i].name;
+        object.symbols[i].defined = symbols[i].defined;
+        object.symbols[i].global = !symbols[i].defined;
+        object.symbols[i].offset = symbols[i].defined ? symbols[i].address : 0;
+    }
+    for (const Fixup& exported : exports)
+        object.symbols[exported.symbol].global = true;
+    for (const Fixup& fixup : fixups)
+        object.relocations.push_back(
+            {0, uint32_t(fixup.offset), uint32_t(fixup.symbol)});
+    return object;
+}
+
+void Assembler::finish() {
+    AssemblyStats::Timer timer(stats, AssemblyStats::EMITTING);
+    // A program with errors is only checked for more of them, not
+    // optimized.
+    if (optimizer.has_value() && diagnostics.empty())
+        optimizer->run(program,
+                       [this](size_t line) { return describeLine(line); });
+    layout();
+    resolveSymbols();
+    if (!diagnostics.empty())
+        throw std::runtime_error(diagnostics.report());
+    if (stats != nullptr)
+        stats->bytesEmitted = image.size();
+}
+
+void Assembler::padTo(size_t size) {
+    if (image.size() > size)
+        throw std::runtime_error(
+            "Source code is too big to be compiled to file of size: " +
+            std::to_string(size));
+    if (stats != nullptr)
+        stats->paddingBytes = size - image.size();
+    image.resize(size, 0);
+}
+
+std::span<const uint8_t> Assembler::assemble(std::string_view source) {
+    reset();
+    forEachLine(source, [this](std::string_view line, size_t lineNumber) {
+        translateLine(line, lineNumber);
+    });
+    finish();
+    return image;
+}
+
+std::span<const uint8_t> Assembler::assemble(std::string_view source,
+                                             std::span<uint8_t> buffer) {
+    std::span<const uint8_t> code = assemble(source);
+    if (code.size() > buffer.size())
+        throw std::runtime_error(
+            sourceName + ": " + std::to_string(code.size()) +
+            " bytes of code do not fit into a buffer of " +
+            std::to_string(buffer.size()) + " bytes!");
+    std::copy(code.begin(), code.end(), buffer.begin());
+    return buffer.first(code.size());
+}
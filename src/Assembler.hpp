@@ -0,0 +1,166 @@
+#ifndef ASSEMBLER_HPP
+#define ASSEMBLER_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Diagnostics.hpp"
+#include "IR.hpp"
+#include "Lexer.hpp"
+#include "LineTable.hpp"
+#include "ObjectFile.hpp"
+#include "Peephole.hpp"
+#include "Stats.hpp"
+#include "SymbolTable.hpp"
+#include "Types.hpp"
+
+// The in-memory core of the assembler: source text in, machine code out,
+// with no files involved. One Assembler can be reused for any number of
+// programs; its buffers keep their capacity between them, so assembling
+// many small programs allocates only while they keep growing.
+//
+//     Assembler assembler;
+//     std::span<const uint8_t> code = assembler.assemble("LDA 01\nHLT");
+//
+// Errors do not stop the assembly: every one found is collected, and
+// finish() throws a single std::runtime_error listing them all, each as
+// "name:line:column: message" (see Diagnostics).
+//
+// ".global name..." lines export labels for separate compilation: with
+// setRelocatable(true), labels the program uses but does not define are
+// left to the linker, and getObject() returns the code with every label
+// reference as a relocation.
+class Assembler {
+  public:
+    // One source line after parsing: an optional label definition and an
+    // optional instruction, validated and encoded. Names are views into the
+    // line's text.
+    struct ParsedLine {
+        std::string_view label;
+        SourcePosition labelPosition;
+        const CommandDescriptor* command = nullptr;
+        std::array<Operand, 2> operands;
+        size_t operandCount = 0;
+        Encoding encoding;
+        std::string_view symbol;  // label patched into the last byte
+        SourcePosition symbolPosition;
+        std::string error;  // set when parseLine fails
+        size_t errorToken = 0;  // index of the token error is about
+
+        std::span<const Operand> getOperands() const {
+            return {operands.data(), operandCount};
+        }
+    };
+
+  private:
+    std::string sourceName;
+    bool optimize = false;
+    std::vector<uint8_t> image;
+
+    TokenList tokens;
+    ParsedLine parsed;
+    Program program;
+
+    struct Fixup {
+        size_t offset;
+        size_t symbol;
+        SourcePosition position;
+    };
+    SymbolTable symbols;
+    std::vector<Fixup> fixups;
+    std::vector<Fixup> exports;  // offset unused
+    bool relocatable = false;
+
+    Diagnostics diagnostics;
+    const LineMap* lineMap = nullptr;
+    std::optional<PeepholeOptimizer> optimizer;
+    AssemblyStats* stats = nullptr;
+    LineTable* lineTable = nullptr;
+
+    static std::string typeMap(OperandType type);
+    std::string describeLine(size_t lineNumber) const;
+
+    void write(const Encoding& encoding) {
+        image.insert(image.end(), encoding.bytes.begin(),
+                     encoding.bytes.begin() + encoding.size);
+    }
+
+    void layout();
+    void resolveSymbols();
+    void addExports(const TokenList& tokens, std::string_view line);
+
+  public:
+    // What is wrong with operands for command, or an empty string. token
+    // is set to the offending token: 0 for the mnemonic, n for operand n-1.
+    static std::string checkOperands(const CommandDescriptor* command,
+                                     std::span<const Operand> operands,
+                                     size_t& token);
+
+    explicit Assembler(std::string sourceName = "<memory>",
+                       bool optimize = false);
+
+    // Starts collecting timings and counters into stats, or stops with
+    // nullptr. The caller keeps stats alive while it is set.
+    void setStats(AssemblyStats* target) { stats = target; }
+
+    // Records every emitted instruction and label into table during layout,
+    // under the line numbers given to translateLine, or stops with nullptr.
+    // The caller keeps table alive while it is set.
+    void setLineTable(LineTable* table) { lineTable = table; }
+
+    // Makes finish() accept labels that are used but not defined, for
+    // getObject(); the image then holds 0 in their place.
+    void setRelocatable(bool value) { relocatable = value; }
+
+    // Reports the line numbers given to translateLine as the places map
+    // says they came from (see Preprocessor), or as they are with nullptr.
+    // The caller keeps map alive while it is set.
+    void setLineMap(const LineMap* map) {
+        lineMap = map;
+        diagnostics.setLineMap(map);
+    }
+
+    // Forgets the previous program but keeps the allocated buffers.
+    void reset();
+
+    // Line-at-a-time interface for callers that own the input: feed every
+    // line, then finish() once. Lines are only parsed and checked into the
+    // Program; finish() optimizes it, lays it out and patches labels.
+    void translateLine(std::string_view line, size_t lineNumber);
+    void finish();
+
+    // Parses the non-empty tokens of one line without adding it to the
+    // program. Returns false and fills line.error on the first problem.
+    bool parseLine(const TokenList& tokens, ParsedLine& line);
+
+    // Zero-pads the image up to size, or throws if it is already larger.
+    void padTo(size_t size);
+
+    // Assembles a whole program. The result points into this Assembler and
+    // stays valid until it assembles again.
+    std::span<const uint8_t> assemble(std::string_view source);
+
+    // Same, then copies the code from this Assembler's image into the
+    // caller's buffer and returns the used prefix of it, which stays valid
+    // after the next call. Code is still emitted into the image first.
+    // Throws if the program does not fit.
+    std::span<const uint8_t> assemble(std::string_view source,
+                                      std::span<uint8_t> buffer);
+
+    const std::vector<uint8_t>& getImage() const { return image; }
+    // The finished program as one "text" section with its labels and a
+    // relocation for every label reference.
+    ObjectFile getObject() const;
+    const Diagnostics& getDiagnostics() const { return diagnostics; }
+    Diagnostics& getDiagnostics() { return diagnostics; }
+    const Program& getProgram() const { return program; }
+    const std::optional<PeepholeOptimizer>& getOptimizer() const {
+        return optimizer;
+    }
+};
+
+#endif  // ASSEMBLER_HPP
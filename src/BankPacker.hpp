@@ -0,0 +1,493 @@
+#ifndef BANKPACKER_HPP
+#define BANKPACKER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "Assembler.hpp"
+#include "Emulator.hpp"
+#include "ObjectFile.hpp"
+
+// Links objects into 256-byte banks for a CPU whose bank port selects the
+// bank memory shows (see Emulator). Bank 0 starts with the first object,
+// and an object that can run off its end (it does not end in JMP or HLT)
+// stays right before the next one.
+//
+// References between objects form a weighted graph. Objects are merged
+// along its heaviest edges while they fit into a bank, and the clusters
+// then go to the bank they have the most references to, so few jumps
+// cross banks. A "MV Rx, label" whose Rx goes straight into JMP or JFZ
+// (see jumpsOnly) and whose label lies in another bank gets the address of
+// a stub instead:
+//     MV Rx, bank / OUT Rx, Rport / MV Rx, label / JMP Rx
+// The stubs sit at the top of every bank at the same addresses, so the
+// second half runs in the new bank and Rx ends up holding the label, as
+// without banks, once the jump is taken. Any other use would see the stub
+// instead of the label, so those labels are kept in the same bank, like
+// the labels of the other literals.
+class BankPacker {
+    static constexpr size_t bankSize = 256;
+    static constexpr size_t stubSize = 10;
+    static constexpr size_t stubInstructions = 4;
+    // Weight of a reference that only works within one bank.
+    static constexpr size_t pinned = size_t(1) << 20;
+
+    struct Module {
+        std::string name;
+        ObjectFile object;
+        std::vector<size_t> bases;  // offset of every section in the module
+        std::vector<uint8_t> bytes;
+        size_t unit = 0;
+        size_t address = 0;
+    };
+
+    // A relocation with its label found.
+    struct Reference {
+        size_t module;
+        size_t offset;
+        size_t target;  // module that defines the label
+        size_t targetOffset;
+        std::string symbol;
+        int reg;  // x of a "MV Rx, label" only jumped to, or -1
+    };
+
+    struct Stub {
+        size_t bank;
+        size_t address;
+        uint8_t reg;
+        bool operator<(const Stub& other) const {
+            return std::tie(bank, address, reg) <
+                   std::tie(other.bank, other.address, other.reg);
+        }
+    };
+
+    uint8_t port;
+    std::vector<Module> modules;
+    std::vector<Reference> references;
+    std::vector<size_t> unitSizes;
+    std::vector<size_t> unitBanks;
+    std::map<std::pair<size_t, size_t>, size_t> edges;  // unit pair: weight
+    std::vector<std::vector<size_t>> banks;  // units in address order
+    std::map<Stub, size_t> stubs;  // slot of every stub
+    size_t reserved = 0;
+    size_t crossings = 0;
+
+  public:
+    explicit BankPacker(uint8_t port) : port(port) {}
+
+    void add(std::string name, ObjectFile object) {
+        modules.push_back({std::move(name), std::move(object), {}, {}});
+    }
+
+    // The banks one after another, each bankSize bytes long.
+    std::vector<uint8_t> pack() {
+        std::vector<std::string> errors;
+        if (modules.empty())
+            throw std::runtime_error("Nothing to link!");
+        references.clear();
+        unitSizes.clear();
+        edges.clear();
+        reserved = 0;
+        for (Module& module : modules) {
+            module.bases.clear();
+            module.bytes.clear();
+            for (const ObjectFile::Section& section : module.object.sections) {
+                module.bases.push_back(module.bytes.size());
+                module.bytes.insert(module.bytes.end(), section.bytes.begin(),
+                                    section.bytes.end());
+            }
+            if (module.bytes.size() > bankSize)
+                errors.push_back(module.name + ": " +
+                                 std::to_string(module.bytes.size()) +
+                                 " bytes do not fit into a bank!");
+        }
+        fail(errors);
+        findUnits();
+        findReferences(errors);
+        fail(errors);
+
+        size_t largest = *std::max_element(unitSizes.begin(), unitSizes.end());
+        if (largest > bankSize)
+            throw std::runtime_error(
+                "Objects that run into each other take " +
+                std::to_string(largest) + " bytes, more than a bank; end "
+                "them with JMP or HLT to let them go to different banks!");
+        for (;;) {
+            place(bankSize - reserved);
+            size_t needed = findStubs() * stubSize;
+            if (needed <= reserved)
+                break;
+            reserved = needed;
+            if (reserved + largest > bankSize)
+                throw std::runtime_error(
+                    "The objects need " + std::to_string(needed) +
+                    " bytes of bank switching stubs, which leaves no room "
+                    "for " +
+                    std::to_string(largest) + " bytes of code in one bank!");
+        }
+        return emit(errors);
+    }
+
+    // Bank usage, packing efficiency and what crossing banks costs.
+    std::string report() const {
+        std::ostringstream out;
+        size_t code = 0;
+        size_t stubBytes = stubs.size() * stubSize;
+        for (size_t bank = 0; bank < banks.size(); bank++) {
+            size_t used = 0;
+            std::string names;
+            for (size_t unit : banks[bank])
+                used += unitSizes[unit];
+            for (const Module& module : modules)
+                if (unitBanks[module.unit] == bank)
+                    names += (names.empty() ? "" : ", ") + module.name;
+            code += used;
+            out << "Bank " << bank << ": " << used << " bytes of code, "
+                << bankSize - used - stubBytes << " free (" << names << ")\n";
+        }
+        size_t total = banks.size() * bankSize;
+        out << "Packing: " << banks.size() << " banks, " << code
+            << " bytes of code, " << std::fixed << std::setprecision(1)
+            << 100.0 * code / total << "% of " << total << " bytes; "
+            << stubs.size() << " stubs take " << stubBytes
+            << " bytes per bank.\n";
+        out << "Switching: " << crossings
+            << " label references cross banks; each jump through a stub "
+               "costs "
+            << stubInstructions << " instructions and " << stubSize
+            << " cycles more.\n";
+        return out.str();
+    }
+
+  private:
+    static void fail(const std::vector<std::string>& errors) {
+        if (errors.empty())
+            return;
+        std::string report;
+        for (const std::string& error : errors)
+            report += (report.empty() ? "" : "\n") + error;
+        throw std::runtime_error(report);
+    }
+
+    static std::array<uint8_t, 256> memoryOf(const Module& module) {
+        std::array<uint8_t, 256> memory{};
+        std::copy(module.bytes.begin(), module.bytes.end(), memory.begin());
+        return memory;
+    }
+
+    // Whether the value in register reg is only used as a jump target by
+    // the straight-line code from pc on: it must be jumped to before it
+    // is read as data, overwritten or the code ends or leaves. Reads after
+    // a JFZ to it count too, as the JFZ may fall through.
+    static bool jumpsOnly(const std::array<uint8_t, 256>& memory,
+                          size_t size,
+                          size_t pc,
+                          uint8_t reg) {
+        bool jumped = false;
+        while (pc < size) {
+            DecodedInstruction inst = decodeInstruction(memory, pc);
+            bool x = inst.x == reg;
+            bool y = inst.y == reg;
+            switch (inst.op) {
+                case OP_NOP:
+                case OP_LDA:
+                case OP_INC:
+                case OP_DEC:
+                    break;
+                case OP_MV_REG:
+                    if (y)
+                        return false;
+                    [[fallthrough]];
+                case OP_MV_ACC:
+                case OP_MV_IMM:
+                case OP_IN:
+                    if (x)
+                        return jumped;  // overwritten
+                    break;
+                case OP_MV_TO_ACC:
+                case OP_ADD_ACC:
+                case OP_SUB_ACC:
+                case OP_ADD_IMM:
+                case OP_SUB_IMM:
+                case OP_OUT:
+                    if (x)
+                        return false;
+                    break;
+                case OP_ADD_REG:
+                case OP_SUB_REG:
+                    if (x || y)
+                        return false;
+                    break;
+                case OP_JFZ_REG:
+                    if (y)
+                        return false;
+                    [[fallthrough]];
+                case OP_JFZ_ACC:
+                    if (!x)
+                        return jumped;  // leaves on another path
+                    jumped = true;
+                    break;
+                case OP_JMP_REG:
+                    return x || jumped;
+                default:  // JMP A, HLT or an illegal instruction
+                    return jumped;
+            }
+            pc += inst.length;
+        }
+        return jumped;
+    }
+
+    // Splits the modules into runs that fall through into each other.
+    void findUnits() {
+        bool joined = false;  // the previous module runs into this one
+        for (Module& module : modules) {
+            if (!joined)
+                unitSizes.push_back(0);
+            module.unit = unitSizes.size() - 1;
+            unitSizes.back() += module.bytes.size();
+            if (module.bytes.empty())
+                continue;
+            std::array<uint8_t, 256> memory = memoryOf(module);
+            MicroOp last = OP_ILLEGAL;
+            for (size_t pc = 0; pc < module.bytes.size();) {
+                DecodedInstruction inst = decodeInstruction(memory, pc);
+                last = inst.op;
+                pc += inst.length;
+            }
+            joined = last != OP_JMP_ACC && last != OP_JMP_REG && last != OP_HLT;
+        }
+    }
+
+    void findReferences(std::vector<std::string>& errors) {
+        struct Export {
+            size_t module;
+            size_t offset;
+        };
+        std::unordered_map<std::string, Export> exports;
+        for (size_t i = 0; i < modules.size(); i++)
+            for (const ObjectFile::Symbol& symbol : modules[i].object.symbols) {
+                if (!symbol.defined || !symbol.global)
+                    continue;
+                Export location{i, modules[i].bases[symbol.section] +
+                                       symbol.offset};
+                auto [found, added] =
+                    exports.try_emplace(symbol.name, location);
+                if (!added)
+                    errors.push_back(modules[i].name + ": label " +
+                                     symbol.name + " is already defined in " +
+                                     modules[found->second.module].name + "!");
+            }
+
+        for (size_t i = 0; i < modules.size(); i++) {
+            const Module& module = modules[i];
+            std::array<uint8_t, 256> memory = memoryOf(module);
+            std::vector<size_t> starts(module.bytes.size());
+            for (size_t pc = 0; pc < module.bytes.size();) {
+                DecodedInstruction inst = decodeInstruction(memory, pc);
+                for (size_t j = pc; j < pc + inst.length && j < starts.size();
+                     j++)
+                    starts[j] = pc;
+                pc += inst.length;
+            }
+            for (const ObjectFile::Relocation& relocation :
+                 module.object.relocations) {
+                const ObjectFile::Symbol& symbol =
+                    module.object.symbols[relocation.symbol];
+                Reference reference{i, module.bases[relocation.section] +
+                                           relocation.offset,
+                                    i, 0, symbol.name, -1};
+                if (symbol.defined)
+                    reference.targetOffset =
+                        module.bases[symbol.section] + symbol.offset;
+                else if (auto found = exports.find(symbol.name);
+                         found != exports.end()) {
+                    reference.target = found->second.module;
+                    reference.targetOffset = found->second.offset;
+                } else {
+                    errors.push_back(module.name + ": undefined label: " +
+                                     symbol.name + "!");
+                    continue;
+                }
+                size_t start = starts[reference.offset];
+                DecodedInstruction inst = decodeInstruction(memory, start);
+                if (inst.op == OP_MV_IMM && start + 2 == reference.offset &&
+                    jumpsOnly(memory, module.bytes.size(), start + 3, inst.x))
+                    reference.reg = inst.x;
+                references.push_back(reference);
+
+                size_t from = module.unit;
+                size_t to = modules[reference.target].unit;
+                if (from != to)
+                    edges[std::minmax(from, to)] +=
+                        reference.reg < 0 ? pinned : 1;
+            }
+        }
+    }
+
+    // Clusters the units along the heaviest edges, then gives every
+    // cluster the bank it has the most references to.
+    void place(size_t capacity) {
+        std::vector<size_t> parent(unitSizes.size());
+        std::iota(parent.begin(), parent.end(), 0);
+        std::vector<size_t> sizes = unitSizes;
+        auto find = [&](size_t unit) {
+            while (parent[unit] != unit)
+                unit = parent[unit] = parent[parent[unit]];
+            return unit;
+        };
+        std::vector<std::pair<std::pair<size_t, size_t>, size_t>> order(
+            edges.begin(), edges.end());
+        std::stable_sort(order.begin(), order.end(),
+                         [](const auto& a, const auto& b) {
+                             return a.second > b.second;
+                         });
+        for (const auto& [pair, weight] : order) {
+            size_t a = find(pair.first);
+            size_t b = find(pair.second);
+            if (a == b || sizes[a] + sizes[b] > capacity)
+                continue;
+            parent[std::max(a, b)] = std::min(a, b);
+            sizes[std::min(a, b)] += sizes[std::max(a, b)];
+        }
+
+        // Roots are the lowest unit of their cluster, so unit 0 leads.
+        std::vector<size_t> clusters;
+        for (size_t unit = 0; unit < unitSizes.size(); unit++)
+            if (find(unit) == unit)
+                clusters.push_back(unit);
+        std::stable_sort(clusters.begin() + 1, clusters.end(),
+                         [&](size_t a, size_t b) {
+                             return sizes[a] > sizes[b];
+                         });
+
+        banks.clear();
+        std::vector<size_t> used;
+        unitBanks.assign(unitSizes.size(), SIZE_MAX);
+        for (size_t cluster : clusters) {
+            std::vector<size_t> affinity(banks.size(), 0);
+            for (const auto& [pair, weight] : edges) {
+                auto [a, b] = pair;
+                if (find(b) == cluster)
+                    std::swap(a, b);
+                if (find(a) == cluster && unitBanks[b] != SIZE_MAX)
+                    affinity[unitBanks[b]] += weight;
+            }
+            size_t best = banks.size();
+            for (size_t bank = 0; bank < banks.size(); bank++)
+                if (used[bank] + sizes[cluster] <= capacity &&
+                    (best == banks.size() || affinity[bank] > affinity[best]))
+                    best = bank;
+            if (best == banks.size()) {
+                banks.emplace_back();
+                used.push_back(0);
+            }
+            used[best] += sizes[cluster];
+            for (size_t unit = 0; unit < unitSizes.size(); unit++)
+                if (find(unit) == cluster) {
+                    unitBanks[unit] = best;
+                    banks[best].push_back(unit);
+                }
+        }
+        for (std::vector<size_t>& units : banks)
+            std::sort(units.begin(), units.end());
+
+        for (const std::vector<size_t>& units : banks) {
+            size_t address = 0;
+            for (size_t unit : units)
+                for (Module& module : modules)
+                    if (module.unit == unit) {
+                        module.address = address;
+                        address += module.bytes.size();
+                    }
+        }
+    }
+
+    // One stub per label, bank and register reached from another bank.
+    size_t findStubs() {
+        stubs.clear();
+        crossings = 0;
+        for (const Reference& reference : references) {
+            const Module& target = modules[reference.target];
+            size_t bank = unitBanks[target.unit];
+            if (bank == unitBanks[modules[reference.module].unit] ||
+                reference.reg < 0)
+                continue;
+            crossings++;
+            stubs.try_emplace(
+                {bank, target.address + reference.targetOffset,
+                 uint8_t(reference.reg)},
+                stubs.size());
+        }
+        return stubs.size();
+    }
+
+    static std::string hex(size_t value) {
+        const char* digits = "0123456789abcdef";
+        return {digits[value >> 4 & 0xF], digits[value & 0xF]};
+    }
+
+    std::vector<uint8_t> emit(std::vector<std::string>& errors) {
+        if (banks.size() > 256)
+            throw std::runtime_error("The objects need " +
+                                     std::to_string(banks.size()) +
+                                     " banks, more than 256!");
+        std::vector<uint8_t> image(banks.size() * bankSize, 0);
+        size_t first = bankSize - stubs.size() * stubSize;
+        for (const Module& module : modules)
+            std::copy(module.bytes.begin(), module.bytes.end(),
+                      image.begin() + unitBanks[module.unit] * bankSize +
+                          module.address);
+
+        for (const Reference& reference : references) {
+            const Module& module = modules[reference.module];
+            const Module& target = modules[reference.target];
+            size_t bank = unitBanks[target.unit];
+            size_t address = target.address + reference.targetOffset;
+            if (bank != unitBanks[module.unit]) {
+                if (reference.reg < 0) {
+                    errors.push_back(
+                        module.name + ": label " + reference.symbol +
+                        " is in another bank, and only MV Rx, " +
+                        reference.symbol + " followed by a jump to Rx can "
+                        "switch to it!");
+                    continue;
+                }
+                address = first + stubSize * stubs.at({bank, address,
+                                                       uint8_t(reference.reg)});
+            }
+            if (address > 0xFF) {
+                errors.push_back(module.name + ": label " + reference.symbol +
+                                 " at address " + std::to_string(address) +
+                                 " does not fit into 8 bits!");
+                continue;
+            }
+            image[unitBanks[module.unit] * bankSize + module.address +
+                  reference.offset] = address;
+        }
+        fail(errors);
+
+        Assembler assembler("stub");
+        for (const auto& [stub, slot] : stubs) {
+            std::string reg = "R" + std::to_string(stub.reg);
+            std::span<const uint8_t> code = assembler.assemble(
+                "MV " + reg + ", " + hex(stub.bank) + "\nOUT " + reg + ", R" +
+                std::to_string(port) + "\nMV " + reg + ", " +
+                hex(stub.address) + "\nJMP " + reg);
+            for (size_t bank = 0; bank < banks.size(); bank++)
+                std::copy(code.begin(), code.end(),
+                          image.begin() + bank * bankSize + first +
+                              slot * stubSize);
+        }
+        return image;
+    }
+};
+
+#endif  // BANKPACKER_HPP
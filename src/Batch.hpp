@@ -0,0 +1,134 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BuildCache.hpp"
+#include "Translator.hpp"
+
+// Assembles many sources in one process. Workers pull files from a shared
+// atomic cursor; each file gets its own Translator, and the instruction set
+// in CompilerConfig is constexpr, so nothing else is shared between them.
+// Every image is written next to its source with the extension .bin, or
+// .zo for objects.
+class BatchAssembler {
+    std::vector<std::filesystem::path> files;
+    TranslatorOptions options;
+    size_t jobs;
+    BuildCache* cache;
+
+    // Shell-style matching of '*' and '?' against a file name.
+    static bool matches(std::string_view pattern, std::string_view name) {
+        size_t p = 0, n = 0, starP = pattern.npos, starN = 0;
+        while (n < name.size()) {
+            if (p < pattern.size() &&
+                (pattern[p] == '?' || pattern[p] == name[n])) {
+                p++;
+                n++;
+            } else if (p < pattern.size() && pattern[p] == '*') {
+                starP = p++;
+                starN = n;
+            } else if (starP != pattern.npos) {
+                p = starP + 1;
+                n = ++starN;
+            } else
+                return false;
+        }
+        while (p < pattern.size() && pattern[p] == '*')
+            p++;
+        return p == pattern.size();
+    }
+
+    static bool isSource(const std::filesystem::path& path) {
+        return path.extension() == ".z" || path.extension() == ".zasm";
+    }
+
+  public:
+    // Expands directories (recursively, .z/.zasm files only) and globs in
+    // the last path component; plain paths are taken as they are.
+    static std::vector<std::filesystem::path> collectSources(
+        const std::vector<std::string>& inputs) {
+        namespace fs = std::filesystem;
+        std::vector<fs::path> result;
+        for (const std::string& input : inputs) {
+            fs::path path(input);
+            std::string name = path.filename().string();
+            if (fs::is_directory(path)) {
+                for (const auto& entry :
+                     fs::recursive_directory_iterator(path))
+                    if (entry.is_regular_file() && isSource(entry.path()))
+                        result.push_back(entry.path());
+            } else if (name.find_first_of("*?") != name.npos) {
+                fs::path directory =
+                    path.has_parent_path() ? path.parent_path() : ".";
+                for (const auto& entry : fs::directory_iterator(directory))
+                    if (entry.is_regular_file() &&
+                        matches(name, entry.path().filename().string()))
+                        result.push_back(entry.path());
+            } else
+                result.push_back(path);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    BatchAssembler(std::vector<std::filesystem::path> sources,
+                   TranslatorOptions translatorOptions,
+                   size_t jobCount,
+                   BuildCache* buildCache = nullptr)
+        : files(std::move(sources)),
+          options(std::move(translatorOptions)),
+          jobs(std::max<size_t>(1, jobCount)),
+          cache(buildCache) {
+        if (options.outputPath.has_value())
+            throw std::runtime_error(
+                "--output cannot be used when assembling several files!");
+    }
+
+    // Returns the number of files that failed; their errors go to errors.
+    size_t run(std::ostream& errors) {
+        std::atomic<size_t> next = 0;
+        std::atomic<size_t> failed = 0;
+        std::mutex errorsMutex;
+
+        auto worker = [&] {
+            TranslatorOptions fileOptions = options;
+            for (size_t i = next++; i < files.size(); i = next++) {
+                try {
+                    fileOptions.outputPath =
+                        std::filesystem::path(files[i])
+                            .replace_extension(options.object ? ".zo"
+                                                              : ".bin")
+                            .string();
+                    if (cache != nullptr)
+                        cache->assemble(files[i].string(), fileOptions);
+                    else
+                        Translator(files[i].string(), fileOptions).run();
+                } catch (const std::exception& e) {
+                    failed++;
+                    std::string message = e.what();
+                    if (!message.starts_with(files[i].string()))
+                        message = files[i].string() + ": " + message;
+                    std::lock_guard lock(errorsMutex);
+                    errors << message << "\n";
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < std::min(jobs, files.size()); i++)
+            workers.emplace_back(worker);
+        worker();
+        for (std::thread& thread : workers)
+            thread.join();
+        return failed;
+    }
+};
+
+#endif  // BATCH_HPP
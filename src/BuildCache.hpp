@@ -0,0 +1,114 @@
+#ifndef BUILDCACHE_HPP
+#define BUILDCACHE_HPP
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <system_error>
+#include "Hash.hpp"
+#include "Translator.hpp"
+
+// Fingerprint of the instruction set the cache keys depend on. Bump
+// revision when the encoders change without the descriptors changing.
+constexpr uint64_t hashInstructionSet(uint64_t revision) {
+    uint64_t hash = Hash::fnv1a("asmz", revision);
+    for (const CommandDescriptor* desc : builtinCommands) {
+        hash = Hash::fnv1a(desc->name, hash);
+        const char fields[] = {char(desc->type), desc->code,
+                               char(desc->opcount),
+                               desc->suitableOperandTypes[0],
+                               desc->suitableOperandTypes[1]};
+        hash = Hash::fnv1a({fields, sizeof(fields)}, hash);
+    }
+    return hash;
+}
+
+// On-disk cache of assembled images, keyed by the source bytes, the bytes
+// of every file it includes, every option that changes the emitted bytes
+// and the instruction set. A hit
+// copies the stored image to the output path without running Translator.
+class BuildCache {
+    std::filesystem::path directory;
+    std::atomic<size_t> hits = 0;
+    std::atomic<size_t> misses = 0;
+
+    std::filesystem::path entryPath(uint64_t key) const {
+        char name[21];
+        std::snprintf(name, sizeof(name), "%016llx.img",
+                      (unsigned long long)key);
+        return directory / name;
+    }
+
+  public:
+    static constexpr uint64_t instructionSetVersion = hashInstructionSet(1);
+
+    explicit BuildCache(std::filesystem::path cacheDirectory)
+        : directory(std::move(cacheDirectory)) {
+        std::filesystem::create_directories(directory);
+    }
+
+    static uint64_t keyFor(std::string_view source,
+                           const TranslatorOptions& options) {
+        uint64_t key = Hash::bytes(source, instructionSetVersion);
+        key = Hash::mix(key ^ options.targetSize);
+        key = Hash::mix(key ^ uint64_t(options.format));
+        key = Hash::mix(key ^ uint64_t(options.optimize));
+        key = Hash::mix(key ^ uint64_t(options.object));
+        return key;
+    }
+
+    // Assembles path into its output, reusing a cached image when the key
+    // matches. Standard input and other non-regular files are never cached,
+    // and neither are sources with an .include that cannot be followed
+    // without expanding macros.
+    void assemble(const std::string& path, const TranslatorOptions& options) {
+        if (path == "-" || !std::filesystem::is_regular_file(path)) {
+            Translator(path, options).run();
+            return;
+        }
+
+        std::filesystem::path output = options.resolveOutputPath(path);
+        uint64_t key;
+        {
+            SourceFile source(path);
+            auto includes = Preprocessor::dependencies(path, source.text());
+            if (!includes.has_value()) {
+                Translator(path, options).run();
+                return;
+            }
+            key = keyFor(source.text(), options);
+            for (const auto& file : *includes)
+                key = Hash::bytes(file->text, key);
+        }
+        std::filesystem::path entry = entryPath(key);
+
+        std::error_code error;
+        if (std::filesystem::copy_file(
+                entry, output,
+                std::filesystem::copy_options::overwrite_existing, error)) {
+            hits++;
+            return;
+        }
+
+        misses++;
+        Translator(path, options).run();
+
+        // Publish through a rename so concurrent batch workers never see
+        // a half-written entry. The temporary name is random, since other
+        // processes may share the cache, and copy_file refuses to replace
+        // an existing file, so a clash skips the entry instead of mixing
+        // two writers' bytes.
+        std::filesystem::path temporary = entry;
+        temporary += "." + std::to_string(std::random_device{}()) + ".tmp";
+        std::filesystem::copy_file(output, temporary, error);
+        if (!error)
+            std::filesystem::rename(temporary, entry, error);
+    }
+
+    size_t getHits() const { return hits; }
+    size_t getMisses() const { return misses; }
+};
+
+#endif  // BUILDCACHE_HPP
@@ -7,39 +7,44 @@
 #include <string>
 #include <unordered_map>
 #include <vector>
-#include "CompilerConfig.hpp"
 
+// Arguments starting with "--" are flags (--name or --name=value), checked
+// against acceptableFlags; everything else is an input path.
 struct InputInfo {
-    InputInfo(int argc, char** argv) {
-        CompilerConfig cfg{};
-        if (argc < 2)
-            throw std::runtime_error("Not enough arguments!");
-        input = argv[1];
-
-        for (int i = 2; i < argc; i++) {
+    InputInfo(int argc,
+              char** argv,
+              const std::vector<std::string>& acceptableFlags) {
+        for (int i = 1; i < argc; i++) {
             std::string name;
             std::string value;
 
             std::string arg(argv[i]);
-            int index = arg.find('=');
+            if (!arg.starts_with("--")) {
+                inputs.push_back(arg);
+                continue;
+            }
+
+            size_t index = arg.find('=');
             if (index != std::string::npos) {
                 name = arg.substr(0, index);
                 value = arg.substr(index + 1, arg.length() - index - 1);
             } else
                 name = arg;
 
-            if (std::find(cfg.acceptableFlags.begin(),
-                          cfg.acceptableFlags.end(),
-                          name) == cfg.acceptableFlags.end())
+            if (std::find(acceptableFlags.begin(), acceptableFlags.end(),
+                          name) == acceptableFlags.end())
                 throw std::runtime_error("Unknown flag: " + name);
 
             if (flags.contains(name))
                 throw std::runtime_error("Duplicate flag: " + name);
             flags[name] = value;
         }
+        if (inputs.empty())
+            throw std::runtime_error("Not enough arguments!");
     }
 
-    const std::string& getInputPath() { return input; }
+    const std::string& getInputPath() { return inputs.front(); }
+    const std::vector<std::string>& getInputPaths() { return inputs; }
     const std::optional<std::string> getFlag(std::string flag) {
         if (!flags.contains(flag))
             return std::nullopt;
@@ -48,7 +53,7 @@ struct InputInfo {
 
     // private:
     std::unordered_map<std::string, std::string> flags;
-    std::string input;
+    std::vector<std::string> inputs;
 };
 
 // static InputInfo parseCLI(int argc, char** argv) {
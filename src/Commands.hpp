@@ -4,355 +4,385 @@
 #include "Types.hpp"
 
 struct CommandNOP : CommandDescriptor {
-    CommandNOP() {
+    static constexpr uint8_t opcode = 0b00000000;
+
+    constexpr CommandNOP() {
         type = NOP;
         name = "NOP";
-        code = 0b00000000;
+        code = opcode;
 
         opcount = 0;
+        bindEncoders<CommandNOP>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        return {};
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand>) {
+        Encoding result;
+        result.push(opcode);
+        return result;
     }
 };
 
 struct CommandLDA : CommandDescriptor {
-    CommandLDA() {
+    static constexpr uint8_t opcode = 0b00000001;
+
+    constexpr CommandLDA() {
         type = LDA;
         name = "LDA";
-        code = 0b00000001;
+        code = opcode;
 
         opcount = 1;
         suitableOperandTypes = {LITERAL};
+        bindEncoders<CommandLDA>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        char code = operands[0].value;
-        return {code};
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand> operands) {
+        Encoding result;
+        result.push(opcode);
+        result.push(operands[0].value);
+        return result;
     }
 };
 
 struct CommandMV1 : CommandDescriptor {
-    CommandMV1() {
+    static constexpr uint8_t opcode = 0b00010010;
+
+    constexpr CommandMV1() {
         type = MV;
         name = "MV";
-        code = 0b00010010;
+        code = opcode;
 
         opcount = 1;
         suitableOperandTypes = {REGISTER};
+        bindEncoders<CommandMV1>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        char code = 64;
-        code += operands[0].value;
-        return {code};
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand> operands) {
+        Encoding result;
+        result.push(opcode);
+        result.push(64 + operands[0].value);
+        return result;
     }
 };
 
 struct CommandMV2 : CommandDescriptor {
-    CommandMV2() {
+    static constexpr uint8_t opcode = 0b00010010;
+
+    constexpr CommandMV2() {
         type = MV;
         name = "MV";
-        code = 0b00010010;
+        code = opcode;
 
         opcount = 2;
         suitableOperandTypes = {REGISTER, ACCUMULATOR | REGISTER | LITERAL};
+        bindEncoders<CommandMV2>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        std::vector<char> result;
-        char code = 0;
-
-        if (operands[1].type == ACCUMULATOR) {
-            code += operands[0].value;
-            result.push_back(code);
-
-        } else if (operands[1].type == REGISTER) {
-            code += 128;
-            code += operands[1].value * 8;
-            code += operands[0].value;
-            result.push_back(code);
-
-        } else if (operands[1].type == LITERAL) {
-            code += 192;
-            code += operands[0].value;
-            result.push_back(code);
-
-            code = operands[1].value;
-            result.push_back(code);
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand> operands) {
+        Encoding result;
+        result.push(opcode);
+        if constexpr (Second == ACCUMULATOR) {
+            result.push(operands[0].value);
+        } else if constexpr (Second == REGISTER) {
+            result.push(128 + operands[1].value * 8 + operands[0].value);
+        } else if constexpr (Second == LITERAL) {
+            result.push(192 + operands[0].value);
+            result.push(operands[1].value);
         }
-
         return result;
     }
 };
 
 struct CommandADD : CommandDescriptor {
-    CommandADD() {
+    static constexpr uint8_t opcode = 0b00010011;
+
+    constexpr CommandADD() {
         type = ADD;
         name = "ADD";
-        code = 0b00010011;
+        code = opcode;
 
         opcount = 2;
         suitableOperandTypes = {REGISTER | ACCUMULATOR, REGISTER | LITERAL};
+        bindEncoders<CommandADD>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        std::vector<char> result;
-        char code = 0;
-
-        if (operands[0].type == ACCUMULATOR) {
-            if (operands[1].type == REGISTER) {
-                code += operands[1].value;
-                result.push_back(code);
-            } else if (operands[1].type == LITERAL) {
-                //?
-            }
-        } else if (operands[0].type == REGISTER) {
-            if (operands[1].type == REGISTER) {
-                code += 128;
-                code += operands[0].value * 8;
-                code += operands[1].value;
-                result.push_back(code);
-            } else if (operands[1].type == LITERAL) {
-                code += 192;
-                code += operands[0].value;
-                result.push_back(code);
-
-                code = operands[1].value;
-                result.push_back(code);
-            }
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand> operands) {
+        Encoding result;
+        // There is no accumulator-immediate mode: leaves this unbound.
+        if constexpr (First == ACCUMULATOR && Second == LITERAL)
+            return result;
+        result.push(opcode);
+        if constexpr (First == ACCUMULATOR && Second == REGISTER) {
+            result.push(operands[1].value);
+        } else if constexpr (First == REGISTER && Second == REGISTER) {
+            result.push(128 + operands[0].value * 8 + operands[1].value);
+        } else if constexpr (First == REGISTER && Second == LITERAL) {
+            result.push(192 + operands[0].value);
+            result.push(operands[1].value);
         }
-
         return result;
     }
 };
 
 struct CommandSUB : CommandDescriptor {
-    CommandSUB() {
+    static constexpr uint8_t opcode = 0b00010100;
+
+    constexpr CommandSUB() {
         type = SUB;
         name = "SUB";
-        code = 0b00010100;
+        code = opcode;
 
         opcount = 2;
         suitableOperandTypes = {REGISTER | ACCUMULATOR, REGISTER | LITERAL};
+        bindEncoders<CommandSUB>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        std::vector<char> result;
-        char code = 0;
-
-        if (operands[0].type == ACCUMULATOR) {
-            if (operands[1].type == REGISTER) {
-                code += operands[1].value;
-                result.push_back(code);
-            } else if (operands[1].type == LITERAL) {
-                //?
-            }
-        } else if (operands[0].type == REGISTER) {
-            if (operands[1].type == REGISTER) {
-                code += 128;
-                code += operands[0].value * 8;
-                code += operands[1].value;
-                result.push_back(code);
-            } else if (operands[1].type == LITERAL) {
-                code += 192;
-                code += operands[0].value;
-                result.push_back(code);
-
-                code = operands[1].value;
-                result.push_back(code);
-            }
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand> operands) {
+        Encoding result;
+        // There is no accumulator-immediate mode: leaves this unbound.
+        if constexpr (First == ACCUMULATOR && Second == LITERAL)
+            return result;
+        result.push(opcode);
+        if constexpr (First == ACCUMULATOR && Second == REGISTER) {
+            result.push(operands[1].value);
+        } else if constexpr (First == REGISTER && Second == REGISTER) {
+            result.push(128 + operands[0].value * 8 + operands[1].value);
+        } else if constexpr (First == REGISTER && Second == LITERAL) {
+            result.push(192 + operands[0].value);
+            result.push(operands[1].value);
         }
-
         return result;
     }
 };
 
 struct CommandINC : CommandDescriptor {
-    CommandINC() {
+    static constexpr uint8_t opcode = 0b10000101;
+
+    constexpr CommandINC() {
         type = INC;
         name = "INC";
-        code = 0b10000101;
+        code = opcode;
 
         opcount = 0;
+        bindEncoders<CommandINC>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        return {};
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand>) {
+        Encoding result;
+        result.push(opcode);
+        return result;
     }
 };
 
 struct CommandDEC : CommandDescriptor {
-    CommandDEC() {
+    static constexpr uint8_t opcode = 0b10000110;
+
+    constexpr CommandDEC() {
         type = DEC;
         name = "DEC";
-        code = 0b10000110;
+        code = opcode;
 
         opcount = 0;
+        bindEncoders<CommandDEC>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        return {};
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand>) {
+        Encoding result;
+        result.push(opcode);
+        return result;
     }
 };
 
 struct CommandJMP : CommandDescriptor {
-    CommandJMP() {
+    static constexpr uint8_t opcode = 0b00000111;
+
+    constexpr CommandJMP() {
         type = JMP;
         name = "JMP";
-        code = 0b00000111;
+        code = opcode;
 
         opcount = 1;
         suitableOperandTypes = {REGISTER | ACCUMULATOR};
+        bindEncoders<CommandJMP>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        std::vector<char> result;
-        char code = 0;
-
-        if (operands[0].type == ACCUMULATOR) {
-            code = 0;
-            result.push_back(code);
-        } else if (operands[0].type == REGISTER) {
-            code += 192;
-            code += operands[0].value;
-            result.push_back(code);
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand> operands) {
+        Encoding result;
+        result.push(opcode);
+        if constexpr (First == ACCUMULATOR) {
+            result.push(0);
+        } else if constexpr (First == REGISTER) {
+            result.push(192 + operands[0].value);
         }
-
         return result;
     }
 };
 
 struct CommandJFZ : CommandDescriptor {
-    CommandJFZ() {
+    static constexpr uint8_t opcode = 0b00001000;
+
+    constexpr CommandJFZ() {
         type = JFZ;
         name = "JFZ";
-        code = 0b00001000;
+        code = opcode;
 
         opcount = 2;
         suitableOperandTypes = {REGISTER | ACCUMULATOR, REGISTER};
+        bindEncoders<CommandJFZ>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        std::vector<char> result;
-        char code = 0;
-
-        if (operands[0].type == ACCUMULATOR) {
-            code = operands[1].value;
-            result.push_back(code);
-        } else if (operands[0].type == REGISTER) {
-            code += 192;
-            code += operands[0].value * 8;
-            code += operands[1].value;
-            result.push_back(code);
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand> operands) {
+        Encoding result;
+        result.push(opcode);
+        if constexpr (First == ACCUMULATOR) {
+            result.push(operands[1].value);
+        } else if constexpr (First == REGISTER) {
+            result.push(192 + operands[0].value * 8 + operands[1].value);
         }
-
         return result;
     }
 };
 
 struct CommandIN : CommandDescriptor {
-    CommandIN() {
+    static constexpr uint8_t opcode = 0b00000101;
+
+    constexpr CommandIN() {
         type = IN;
         name = "IN";
-        code = 0b00000101;
+        code = opcode;
 
         opcount = 2;
         suitableOperandTypes = {REGISTER, REGISTER};
+        bindEncoders<CommandIN>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        char code = operands[0].value;
-        code += operands[1].value * 8;
-        return {code};
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand> operands) {
+        Encoding result;
+        result.push(opcode);
+        result.push(operands[0].value + operands[1].value * 8);
+        return result;
     }
 };
 
 struct CommandOUT : CommandDescriptor {
-    CommandOUT() {
+    static constexpr uint8_t opcode = 0b00000110;
+
+    constexpr CommandOUT() {
         type = OUT;
         name = "OUT";
-        code = 0b00000110;
+        code = opcode;
 
         opcount = 2;
         suitableOperandTypes = {REGISTER, REGISTER};
+        bindEncoders<CommandOUT>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        char code = operands[0].value;
-        code += operands[1].value * 8;
-        return {code};
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand> operands) {
+        Encoding result;
+        result.push(opcode);
+        result.push(operands[0].value + operands[1].value * 8);
+        return result;
     }
 };
 
 struct CommandPUSH : CommandDescriptor {
-    CommandPUSH() {
+    static constexpr uint8_t opcode = 0b00001001;
+
+    constexpr CommandPUSH() {
         type = PUSH;
         name = "PUSH";
-        code = 0b00001001;
+        code = opcode;
 
         opcount = 2;
         suitableOperandTypes = {REGISTER | ACCUMULATOR};
+        bindEncoders<CommandPUSH>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        char code = operands[0].value;
-        code += operands[1].value * 8;
-        return {code};
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand> operands) {
+        Encoding result;
+        result.push(opcode);
+        result.push(operands[0].value + operands[1].value * 8);
+        return result;
     }
 };
 
 struct CommandPOP : CommandDescriptor {
-    CommandPOP() {
+    static constexpr uint8_t opcode = 0b00001010;
+
+    constexpr CommandPOP() {
         type = POP;
         name = "POP";
-        code = 0b00001010;
+        code = opcode;
 
         opcount = 2;
         suitableOperandTypes = {REGISTER | ACCUMULATOR};
+        bindEncoders<CommandPOP>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        char code = 0;
-        if (operands[0].type == ACCUMULATOR) {
-            code = 0;
-        } else if (operands[0].type == REGISTER) {
-            code += 192;
-            code += operands[0].value;
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand> operands) {
+        Encoding result;
+        result.push(opcode);
+        if constexpr (First == ACCUMULATOR) {
+            result.push(0);
+        } else if constexpr (First == REGISTER) {
+            result.push(192 + operands[0].value);
         }
-        return {code};
+        return result;
     }
 };
 
 struct CommandHLT : CommandDescriptor {
-    CommandHLT() {
+    static constexpr uint8_t opcode = 0b11111111;
+
+    constexpr CommandHLT() {
         type = HLT;
         name = "HLT";
-        code = 0b11111111;
+        code = opcode;
 
         opcount = 0;
+        bindEncoders<CommandHLT>();
     }
 
-    std::vector<char> compile(std::vector<Operand>& operands) const override {
-        return {};
+    template <OperandType First, OperandType Second>
+    static constexpr Encoding encode(std::span<const Operand>) {
+        Encoding result;
+        result.push(opcode);
+        return result;
     }
 };
 
-inline static CommandNOP cNOP{};
-inline static CommandLDA cLDA{};
-inline static CommandMV1 cMV1{};
-inline static CommandMV2 cMV2{};
-inline static CommandADD cADD{};
-inline static CommandSUB cSUB{};
-inline static CommandINC cINC{};
-inline static CommandDEC cDEC{};
-inline static CommandJMP cJMP{};
-inline static CommandJFZ cJFZ{};
-inline static CommandIN cIN{};
-inline static CommandOUT cOUT{};
-inline static CommandPUSH cPUSH{};
-inline static CommandPOP cPOP{};
-inline static CommandHLT cHLT{};
+inline constexpr CommandNOP cNOP{};
+inline constexpr CommandLDA cLDA{};
+inline constexpr CommandMV1 cMV1{};
+inline constexpr CommandMV2 cMV2{};
+inline constexpr CommandADD cADD{};
+inline constexpr CommandSUB cSUB{};
+inline constexpr CommandINC cINC{};
+inline constexpr CommandDEC cDEC{};
+inline constexpr CommandJMP cJMP{};
+inline constexpr CommandJFZ cJFZ{};
+inline constexpr CommandIN cIN{};
+inline constexpr CommandOUT cOUT{};
+inline constexpr CommandPUSH cPUSH{};
+inline constexpr CommandPOP cPOP{};
+inline constexpr CommandHLT cHLT{};
+
+// The instruction set the assembler accepts, in registry order.
+inline constexpr std::array<const CommandDescriptor*, 15> builtinCommands = {
+    &cNOP, &cLDA, &cMV1, &cMV2, &cADD,  &cSUB, &cINC, &cDEC,
+    &cJMP, &cJFZ, &cIN,  &cOUT, &cPUSH, &cPOP, &cHLT};
 
 #endif  // COMMANDS_HPP
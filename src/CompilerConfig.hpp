@@ -2,49 +2,103 @@
 #define COMPILERCONFIG_HPP
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
+#include "Commands.hpp"
 #include "Types.hpp"
 
+// Packs a mnemonic of up to four characters and its arity into one key.
+// Longer names cannot be instructions and map to 0, which matches no slot.
+constexpr uint64_t mnemonicKey(std::string_view name, size_t opcount) {
+    if (name.empty() || name.length() > 4)
+        return 0;
+    uint64_t key = uint64_t(opcount) << 32;
+    for (size_t i = 0; i < name.length(); i++)
+        key |= uint64_t((unsigned char)name[i]) << (i * 8);
+    return key;
+}
+
+// Mnemonic/arity lookup through a perfect hash found at compile time, so
+// resolving an instruction is one multiply, one shift and one compare.
 struct CommandRegistry {
-    std::vector<CommandDescriptor*> impl;
-    //    const CommandDescriptor* getByName(std::string name) {
-    //        auto iterator = std::find_if(
-    //            impl.begin(), impl.end(),
-    //            [&](const CommandDescriptor* desc) { return desc->name ==
-    //            name; });
-    //        if (iterator == impl.end())
-    //            throw std::runtime_error("No such instruction: " + name +
-    //            "!");
-    //        return *iterator;
-    //    }
-
-    const CommandDescriptor* getByName(std::string name, int opcount) {
-        auto iterator = std::find_if(
-            impl.begin(), impl.end(), [&](const CommandDescriptor* desc) {
-                return desc->name == name && desc->opcount == opcount;
-            });
-        if (iterator == impl.end())
-            throw std::runtime_error("No such instruction: " + name + "!");
-        return *iterator;
+    static constexpr size_t tableBits = 6;
+
+    struct Slot {
+        uint64_t key = 0;
+        const CommandDescriptor* descriptor = nullptr;
+    };
+
+    uint64_t multiplier = 0;
+    std::array<Slot, size_t(1) << tableBits> slots{};
+    std::array<const CommandDescriptor*, HLT + 1> byType{};
+
+    template <size_t N>
+    consteval CommandRegistry(
+        const std::array<const CommandDescriptor*, N>& descriptors) {
+        static_assert(2 * N <= (size_t(1) << tableBits),
+                      "Command table is too small for the instruction set");
+
+        for (uint64_t attempt = 0; multiplier == 0; attempt++) {
+            if (attempt == 4096)
+                throw "No perfect hash found for the instruction set";
+            uint64_t candidate = 0x9E3779B97F4A7C15ull + attempt * 2;
+            std::array<bool, size_t(1) << tableBits> used{};
+            bool collision = false;
+            for (const CommandDescriptor* desc : descriptors) {
+                size_t index = slotOf(
+                    mnemonicKey(desc->name, desc->opcount), candidate);
+                collision = collision || used[index];
+                used[index] = true;
+            }
+            if (!collision)
+                multiplier = candidate;
+        }
+
+        for (const CommandDescriptor* desc : descriptors) {
+            uint64_t key = mnemonicKey(desc->name, desc->opcount);
+            slots[slotOf(key, multiplier)] = {key, desc};
+            if (byType[desc->type] == nullptr)
+                byType[desc->type] = desc;
+        }
+    }
+
+    static constexpr size_t slotOf(uint64_t key, uint64_t multiplier) {
+        return (key * multiplier) >> (64 - tableBits);
+    }
+
+    constexpr const CommandDescriptor* findByName(std::string_view name,
+                                                  size_t opcount) const {
+        uint64_t key = mnemonicKey(name, opcount);
+        const Slot& slot = slots[slotOf(key, multiplier)];
+        return slot.key == key ? slot.descriptor : nullptr;
+    }
+
+    const CommandDescriptor* getByName(std::string_view name,
+                                       size_t opcount) const {
+        const CommandDescriptor* desc = findByName(name, opcount);
+        if (desc == nullptr)
+            throw std::runtime_error("No such instruction: " +
+                                     std::string(name) + "!");
+        return desc;
     }
 
-    const CommandDescriptor* getByType(CommandType type) {
-        auto iterator = std::find_if(
-            impl.begin(), impl.end(),
-            [&](const CommandDescriptor* desc) { return desc->type == type; });
-        if (iterator == impl.end())
+    const CommandDescriptor* getByType(CommandType type) const {
+        if (type < 0 || type >= byType.size() || byType[type] == nullptr)
             throw std::runtime_error(
                 "No such instruction: " + std::to_string(type) + "!");
-        return *iterator;
+        return byType[type];
     }
 };
 
+// Shared, immutable configuration: safe to read from any number of
+// concurrently running translations.
 struct CompilerConfig {
-    inline static std::vector<std::string> acceptableFlags;
-    inline static CommandRegistry commands;
+    inline static constexpr CommandRegistry commands{builtinCommands};
 };
 
 #endif  // COMPILERCONFIG_HPP
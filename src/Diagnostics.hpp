@@ -0,0 +1,171 @@
+#ifndef DIAGNOSTICS_HPP
+#define DIAGNOSTICS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Lexer.hpp"
+
+struct Diagnostic {
+    SourcePosition position;
+    std::string token;    // the offending token
+    std::string message;
+    std::string line;     // source line for the excerpt, if still at hand
+};
+
+// Where the lines an Assembler was fed came from, when they are not simply
+// the lines of one file: the preprocessor numbers the lines it feeds in
+// order, and a run of consecutive lines from one place in one file shares a
+// single entry. Lines produced by a macro expansion point into the macro's
+// definition and name the expansion, which in turn records where the macro
+// was invoked.
+class LineMap {
+  public:
+    struct Location {
+        const std::string* file = nullptr;  // outlives the map
+        size_t line = 0;
+        int32_t expansion = -1;  // index into expansions, or -1
+    };
+
+    struct Expansion {
+        std::string macro;
+        Location invocation;
+    };
+
+  private:
+    struct Run {
+        size_t first;  // fed line number of the run's first line
+        Location location;
+    };
+
+    std::vector<Run> runs;
+    std::vector<Expansion> expansions;
+
+  public:
+    void add(size_t line, Location location) {
+        if (!runs.empty()) {
+            const Run& run = runs.back();
+            if (run.location.file == location.file &&
+                run.location.expansion == location.expansion &&
+                run.location.line + (line - run.first) == location.line)
+                return;
+        }
+        runs.push_back({line, location});
+    }
+
+    int32_t addExpansion(std::string macro, Location invocation) {
+        expansions.push_back({std::move(macro), invocation});
+        return expansions.size() - 1;
+    }
+
+    Location locate(size_t line) const {
+        auto run = std::upper_bound(
+            runs.begin(), runs.end(), line,
+            [](size_t line, const Run& run) { return line < run.first; });
+        if (run == runs.begin())
+            return {};
+        --run;
+        Location result = run->location;
+        result.line += line - run->first;
+        return result;
+    }
+
+    const Expansion& expansion(int32_t index) const {
+        return expansions[index];
+    }
+    size_t expansionCount() const { return expansions.size(); }
+
+    void clear() {
+        runs.clear();
+        expansions.clear();
+    }
+};
+
+// Every error found in one assembly, in the order they were found. The
+// assembler records an error and moves on to the next line instead of
+// stopping, so one run reports all of them.
+class Diagnostics {
+    std::string sourceName;
+    std::vector<Diagnostic> entries;
+    const LineMap* lineMap = nullptr;
+
+  public:
+    explicit Diagnostics(std::string sourceName)
+        : sourceName(std::move(sourceName)) {}
+
+    void add(SourcePosition position,
+             std::string_view token,
+             std::string message,
+             std::string_view line = {}) {
+        entries.push_back({position, std::string(token), std::move(message),
+                           std::string(line)});
+    }
+
+    bool empty() const { return entries.empty(); }
+    size_t size() const { return entries.size(); }
+    const Diagnostic& operator[](size_t index) const { return entries[index]; }
+    void clear() { entries.clear(); }
+
+    // Line numbers are translated through map from now on, or taken as
+    // they are with nullptr. The caller keeps map alive while it is set.
+    void setLineMap(const LineMap* map) { lineMap = map; }
+
+    // "name:line:column: message", followed by the source line with the
+    // token underlined when the line is known, and by the chain of macro
+    // invocations the line was expanded from.
+    std::string format(const Diagnostic& diagnostic) const {
+        LineMap::Location location;
+        if (lineMap != nullptr)
+            location = lineMap->locate(diagnostic.position.line);
+        if (location.file == nullptr)
+            location = {&sourceName, diagnostic.position.line};
+
+        std::string result = *location.file + ":" +
+                             std::to_string(location.line) + ":" +
+                             std::to_string(diagnostic.position.column) +
+                             ": " + diagnostic.message;
+        if (!diagnostic.line.empty()) {
+            result += "\n    " + diagnostic.line + "\n    ";
+            for (size_t i = 1; i < diagnostic.position.column; i++)
+                result += diagnostic.line[i - 1] == '\t' ? '\t' : ' ';
+            result += '^';
+            if (diagnostic.token.size() > 1)
+                result.append(diagnostic.token.size() - 1, '~');
+        }
+        // A recursive macro repeats one invocation many times over.
+        for (int32_t i = location.expansion; i >= 0;) {
+            const LineMap::Expansion& expansion = lineMap->expansion(i);
+            size_t repeats = 1;
+            i = expansion.invocation.expansion;
+            for (; i >= 0; i = lineMap->expansion(i).invocation.expansion) {
+                const LineMap::Expansion& next = lineMap->expansion(i);
+                if (next.macro != expansion.macro ||
+                    next.invocation.file != expansion.invocation.file ||
+                    next.invocation.line != expansion.invocation.line)
+                    break;
+                repeats++;
+            }
+            result += "\n    in expansion of " + expansion.macro + " at " +
+                      *expansion.invocation.file + ":" +
+                      std::to_string(expansion.invocation.line);
+            if (repeats > 1)
+                result += " (" + std::to_string(repeats) + " times)";
+        }
+        return result;
+    }
+
+    // All diagnostics, one after another.
+    std::string report() const {
+        std::string result;
+        for (const Diagnostic& diagnostic : entries) {
+            if (!result.empty())
+                result += '\n';
+            result += format(diagnostic);
+        }
+        return result;
+    }
+};
+
+#endif  // DIAGNOSTICS_HPP
@@ -0,0 +1,181 @@
+#ifndef DISASSEMBLER_HPP
+#define DISASSEMBLER_HPP
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Commands.hpp"
+
+// Turns machine code back into source the assembler accepts. The decoding
+// tables are derived from the encoders in Commands.hpp instead of being
+// written out by hand: every bound form of every instruction is encoded
+// once per register combination, and the bytes before the literal (always
+// an encoding's last byte) become the key the form is found by. A new
+// instruction or addressing mode is therefore disassembled as soon as it
+// can be assembled.
+class Disassembler {
+    struct Form {
+        const CommandDescriptor* command = nullptr;
+        std::array<Operand, 2> operands;  // the literal's value is decoded
+        uint8_t count = 0;
+        uint8_t length = 0;
+        int8_t literal = -1;  // index of the literal operand, if any
+    };
+
+    static constexpr uint8_t registerCount = 8;
+
+    std::vector<Form> forms;
+    std::array<int16_t, 256> byOpcode;  // forms keyed by one byte
+    std::unordered_map<uint16_t, int16_t> byPrefix;  // and by two
+
+    void add(Form form) {
+        std::span<const Operand> operands{form.operands.data(), form.count};
+        Encoding encoding = form.command->encode(operands);
+        form.length = encoding.size;
+        size_t prefix = encoding.size - (form.literal >= 0 ? 1 : 0);
+        int16_t index = forms.size();
+        // Registry order decides between forms with the same bytes.
+        if (prefix == 1 && byOpcode[encoding.bytes[0]] < 0)
+            byOpcode[encoding.bytes[0]] = index;
+        else if (prefix == 2)
+            byPrefix.try_emplace(encoding.bytes[0] << 8 | encoding.bytes[1],
+                                 index);
+        else
+            return;
+        forms.push_back(form);
+    }
+
+    // Fills in operand slot and the ones after it with every register.
+    void enumerate(Form& form, size_t slot) {
+        if (slot == form.count) {
+            add(form);
+            return;
+        }
+        if (form.operands[slot].type != REGISTER) {
+            enumerate(form, slot + 1);
+            return;
+        }
+        for (uint8_t r = 0; r < registerCount; r++) {
+            form.operands[slot].value = r;
+            enumerate(form, slot + 1);
+        }
+    }
+
+    static void appendHex(std::string& out, size_t value, size_t digits) {
+        while (digits-- > 0)
+            out += "0123456789ABCDEF"[(value >> (digits * 4)) & 0xF];
+    }
+
+    static void appendOperand(std::string& out, const Operand& operand) {
+        if (operand.type == ACCUMULATOR)
+            out += 'A';
+        else if (operand.type == REGISTER) {
+            out += 'R';
+            appendHex(out, operand.value, 1);
+        } else
+            appendHex(out, operand.value, 2);
+    }
+
+  public:
+    struct Instruction {
+        size_t address = 0;
+        size_t length = 1;
+        bool valid = false;  // false: a byte that starts no instruction
+        std::string text;
+    };
+
+    Disassembler() {
+        byOpcode.fill(-1);
+        for (const CommandDescriptor* command : builtinCommands)
+            for (size_t i = 0; i < command->encoders.size(); i++) {
+                if (command->encoders[i] == nullptr)
+                    continue;
+                Form form;
+                form.command = command;
+                form.count = command->opcount;
+                for (size_t slot = 0; slot < form.count; slot++) {
+                    OperandType type = operandTypeOfKind(
+                        slot == 0 ? i / 4 : i % 4);
+                    form.operands[slot].type = type;
+                    if (type == LITERAL)
+                        form.literal = slot;
+                }
+                enumerate(form, 0);
+            }
+    }
+
+    Instruction decode(std::span<const uint8_t> image, size_t address) const {
+        Instruction result;
+        result.address = address;
+        int16_t index = byOpcode[image[address]];
+        if (index < 0 && address + 1 < image.size()) {
+            auto found =
+                byPrefix.find(image[address] << 8 | image[address + 1]);
+            if (found != byPrefix.end())
+                index = found->second;
+        }
+        if (index < 0 || address + forms[index].length > image.size()) {
+            result.text = "// ";
+            appendHex(result.text, image[address], 2);
+            result.text += " is not an instruction";
+            return result;
+        }
+
+        Form form = forms[index];
+        result.length = form.length;
+        result.valid = true;
+        if (form.literal >= 0)
+            form.operands[form.literal].value =
+                image[address + form.length - 1];
+        result.text = form.command->name;
+        for (size_t i = 0; i < form.count; i++) {
+            result.text += i == 0 ? " " : ", ";
+            appendOperand(result.text, form.operands[i]);
+        }
+        return result;
+    }
+
+    // One line per instruction. With addresses, each line ends in a
+    // comment with the instruction's address and bytes. Bytes that start
+    // no instruction become comments, so only images the assembler made
+    // assemble back into the same bytes.
+    std::string disassemble(std::span<const uint8_t> image,
+                            bool addresses = true) const {
+        std::string result;
+        for (size_t address = 0; address < image.size();) {
+            Instruction instruction = decode(image, address);
+            if (!instruction.valid && addresses) {
+                result += "// ";
+                appendHex(result, address, address > 0xFFFF ? 8 : 4);
+                result += ": ";
+                appendHex(result, image[address], 2);
+                result += " is not an instruction\n";
+                address++;
+                continue;
+            }
+            result += instruction.text;
+            if (addresses) {
+                result.append(
+                    instruction.text.size() < 16
+                        ? 16 - instruction.text.size()
+                        : 1,
+                    ' ');
+                result += "// ";
+                appendHex(result, address, address > 0xFFFF ? 8 : 4);
+                result += ':';
+                for (size_t i = 0; i < instruction.length; i++) {
+                    result += ' ';
+                    appendHex(result, image[address + i], 2);
+                }
+            }
+            result += '\n';
+            address += instruction.length;
+        }
+        return result;
+    }
+};
+
+#endif  // DISASSEMBLER_HPP
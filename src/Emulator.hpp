@@ -0,0 +1,661 @@
+#ifndef EMULATOR_HPP
+#define EMULATOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Commands.hpp"
+#include "PortRing.hpp"
+
+// Architectural state of the AsmZ CPU described in the README: eight
+// general purpose registers, the accumulator and 256 bytes of memory that
+// hold the program. Port values are latched per port number.
+struct CpuState {
+    std::array<uint8_t, 8> registers{};
+    uint8_t accumulator = 0;
+    uint8_t pc = 0;
+    std::array<uint8_t, 256> memory{};
+    std::array<uint8_t, 8> inputPorts{};
+    std::array<uint8_t, 8> outputPorts{};
+
+    uint64_t instructions = 0;
+    uint64_t cycles = 0;
+};
+
+// Everything in CpuState a run can change or a harness sets up. Memory is
+// left out because nothing can store to it, so taking and restoring a
+// snapshot costs the same for any program.
+struct CpuSnapshot {
+    std::array<uint8_t, 8> registers{};
+    uint8_t accumulator = 0;
+    uint8_t pc = 0;
+    std::array<uint8_t, 8> inputPorts{};
+    std::array<uint8_t, 8> outputPorts{};
+
+    uint64_t instructions = 0;
+    uint64_t cycles = 0;
+};
+
+// PORT_BLOCKED: an IN found its port's ring empty, or an OUT found it full.
+enum class StopReason { HALTED, ILLEGAL_INSTRUCTION, STEP_LIMIT, PORT_BLOCKED };
+constexpr std::array<const char*, 4> stopReasonNames = {
+    "halted", "illegal instruction", "step limit reached", "port blocked"};
+
+// Micro-operations the encodings in Commands.hpp decode to. The operand
+// byte's top two bits select the addressing mode, as in the README:
+// 00000xxx uses the accumulator, 10yyyxxx two registers and 11000xxx an
+// immediate in the following byte (or a register for JMP/JFZ).
+enum MicroOp : uint8_t {
+    OP_NOP,
+    OP_LDA,
+    OP_MV_ACC,  // Rx = Acc
+    OP_MV_TO_ACC,  // Acc = Rx (the one-operand MV form)
+    OP_MV_REG,  // Rx = Ry
+    OP_MV_IMM,  // Rx = Y
+    OP_ADD_ACC,  // Acc += Rx
+    OP_ADD_REG,  // Ry += Rx
+    OP_ADD_IMM,  // Rx += Y
+    OP_SUB_ACC,
+    OP_SUB_REG,
+    OP_SUB_IMM,
+    OP_INC,
+    OP_DEC,
+    OP_JMP_ACC,
+    OP_JMP_REG,
+    OP_JFZ_ACC,  // if Acc == 0: PC = Rx
+    OP_JFZ_REG,  // if Ry == 0: PC = Rx
+    OP_IN,  // Rx = port y
+    OP_OUT,  // port y = Rx
+    OP_HLT,
+    OP_ILLEGAL,
+    MICRO_OP_COUNT
+};
+
+// The mnemonic each micro-operation was assembled from.
+constexpr std::array<const char*, MICRO_OP_COUNT> microOpMnemonics = {
+    "NOP", "LDA", "MV",  "MV",  "MV",  "MV",  "ADD", "ADD",
+    "ADD", "SUB", "SUB", "SUB", "INC", "DEC", "JMP", "JMP",
+    "JFZ", "JFZ", "IN",  "OUT", "HLT", "???"};
+
+struct DecodedInstruction {
+    MicroOp op = OP_ILLEGAL;
+    uint8_t x = 0;  // bits 0-2 of the operand byte
+    uint8_t y = 0;  // bits 3-5 of the operand byte
+    uint8_t immediate = 0;
+    uint8_t length = 1;
+};
+
+// Decodes the instruction starting at address pc. Fetches wrap around the
+// 256-byte address space like the hardware program counter does.
+inline DecodedInstruction decodeInstruction(
+    const std::array<uint8_t, 256>& memory,
+    uint8_t pc) {
+    DecodedInstruction inst;
+    uint8_t operand = memory[uint8_t(pc + 1)];
+    uint8_t mode = operand >> 6;
+    inst.x = operand & 0b111;
+    inst.y = (operand >> 3) & 0b111;
+    inst.immediate = memory[uint8_t(pc + 2)];
+    inst.length = 2;
+
+    auto pick = [&](MicroOp acc, MicroOp reg, MicroOp imm) {
+        if (mode == 0b00 && inst.y == 0)
+            return acc;
+        if (mode == 0b10)
+            return reg;
+        if (mode == 0b11 && inst.y == 0) {
+            inst.length = 3;
+            return imm;
+        }
+        return OP_ILLEGAL;
+    };
+
+    switch (memory[pc]) {
+        case uint8_t(cNOP.code):
+            inst.op = OP_NOP;
+            inst.length = 1;
+            break;
+        case uint8_t(cLDA.code):
+            inst.op = OP_LDA;
+            inst.immediate = operand;
+            break;
+        case uint8_t(cMV2.code):
+            if (mode == 0b01 && inst.y == 0)
+                inst.op = OP_MV_TO_ACC;
+            else
+                inst.op = pick(OP_MV_ACC, OP_MV_REG, OP_MV_IMM);
+            break;
+        case uint8_t(cADD.code):
+            inst.op = pick(OP_ADD_ACC, OP_ADD_REG, OP_ADD_IMM);
+            break;
+        case uint8_t(cSUB.code):
+            inst.op = pick(OP_SUB_ACC, OP_SUB_REG, OP_SUB_IMM);
+            break;
+        case uint8_t(cINC.code):
+            inst.op = OP_INC;
+            inst.length = 1;
+            break;
+        case uint8_t(cDEC.code):
+            inst.op = OP_DEC;
+            inst.length = 1;
+            break;
+        case uint8_t(cJMP.code):
+            if (operand == 0)
+                inst.op = OP_JMP_ACC;
+            else if (mode == 0b11 && inst.y == 0)
+                inst.op = OP_JMP_REG;
+            break;
+        case uint8_t(cJFZ.code):
+            if (mode == 0b00 && inst.y == 0)
+                inst.op = OP_JFZ_ACC;
+            else if (mode == 0b11)
+                inst.op = OP_JFZ_REG;
+            break;
+        case uint8_t(cIN.code):
+            if (mode == 0b00)
+                inst.op = OP_IN;
+            break;
+        case uint8_t(cOUT.code):
+            if (mode == 0b00)
+                inst.op = OP_OUT;
+            break;
+        case uint8_t(cHLT.code):
+            inst.op = OP_HLT;
+            inst.length = 1;
+            break;
+        default:
+            break;
+    }
+    if (inst.op == OP_ILLEGAL)
+        inst.length = 1;
+    return inst;
+}
+
+// Counts of one profiled run, indexed by the address an instruction starts
+// at. Cycles follow from the timing model: an instruction costs its length
+// on every execution.
+struct ExecutionProfile {
+    std::array<uint64_t, 256> executions{};
+    std::array<uint64_t, 256> taken{};  // JFZ only; the rest fell through
+};
+
+// Undo records of the most recently executed instructions, in a ring of
+// fixed capacity that overwrites the oldest record when full. An
+// instruction changes the PC and at most one byte of state, so a record
+// holds the old PC, which byte changed and its old value.
+class UndoJournal {
+  public:
+    // Targets 0-7 are the registers.
+    static constexpr uint8_t accumulatorTarget = 8;
+    static constexpr uint8_t outputPortTarget = 16;  // plus the port number
+    static constexpr uint8_t noTarget = 0xFF;
+
+    struct Entry {
+        uint8_t pc = 0;
+        uint8_t target = noTarget;
+        uint8_t old = 0;
+    };
+
+  private:
+    std::vector<Entry> ring;
+    size_t next = 0;  // where the next record goes
+    size_t count = 0;
+    Entry displaced;  // what the newest record overwrote, for cancel
+    bool wasFull = false;
+
+  public:
+    explicit UndoJournal(size_t capacity = 0) : ring(capacity) {}
+
+    size_t capacity() const { return ring.size(); }
+    size_t size() const { return count; }
+    void clear() { next = count = 0; }
+
+    void push(Entry entry) {
+        displaced = ring[next];
+        wasFull = count == ring.size();
+        ring[next] = entry;
+        next = next + 1 == ring.size() ? 0 : next + 1;
+        count = std::min(count + 1, ring.size());
+    }
+
+    // Removes and returns the newest record.
+    std::optional<Entry> pop() {
+        if (count == 0)
+            return std::nullopt;
+        next = next == 0 ? ring.size() - 1 : next - 1;
+        count--;
+        return ring[next];
+    }
+
+    // Takes back the newest record of an instruction that did not retire,
+    // putting back the one it overwrote.
+    void cancel() {
+        next = next == 0 ? ring.size() - 1 : next - 1;
+        ring[next] = displaced;
+        if (!wasFull)
+            count--;
+    }
+};
+
+// Interpreter over a table with one predecoded instruction per address.
+// Nothing can store to memory, so the table never goes stale. Timing model:
+// every byte fetched costs one cycle, so an instruction takes as many
+// cycles as it is long.
+//
+// An image longer than 256 bytes needs a bank port: the image is split into
+// 256-byte banks, and the value last written to that output port selects
+// the bank that memory shows, from the next instruction on (see
+// BankPacker). Writing the number of a missing bank faults like an illegal
+// instruction.
+class Emulator {
+  public:
+    static constexpr uint8_t noBankPort = 0xFF;
+
+  private:
+    CpuState cpu;
+    std::vector<uint8_t> image;
+    std::vector<DecodedInstruction> tables;  // 256 per bank
+    size_t bankBase = 0;  // the selected bank's first entry in tables
+    uint8_t bankPort = noBankPort;
+    size_t bankCount = 1;
+    UndoJournal journal;
+    std::array<PortRing*, 8> inputRings{};
+    std::array<PortRing*, 8> outputRings{};
+
+  public:
+    explicit Emulator(std::span<const uint8_t> image,
+                      uint8_t bankPort = noBankPort) {
+        load(image, bankPort);
+    }
+
+    void load(std::span<const uint8_t> program,
+              uint8_t port = noBankPort) {
+        size_t size = cpu.memory.size();
+        if (port == noBankPort && program.size() > size)
+            throw std::runtime_error(
+                "Image of " + std::to_string(program.size()) +
+                " bytes does not fit into 256 bytes of memory!");
+        if (port != noBankPort && port >= cpu.outputPorts.size())
+            throw std::runtime_error("No such port: " + std::to_string(port) +
+                                     "!");
+        if (program.size() > size * 256)
+            throw std::runtime_error("Image of " +
+                                     std::to_string(program.size()) +
+                                     " bytes has more than 256 banks!");
+        cpu = CpuState{};
+        journal.clear();
+        bankPort = port;
+        bankCount = std::max<size_t>(1, (program.size() + size - 1) / size);
+        image.assign(program.begin(), program.end());
+        image.resize(bankCount * size, 0);
+        tables.resize(bankCount * size);
+        for (size_t bank = 0; bank < bankCount; bank++) {
+            std::copy_n(image.begin() + bank * size, size,
+                        cpu.memory.begin());
+            for (size_t pc = 0; pc < size; pc++)
+                tables[bank * size + pc] = decodeInstruction(cpu.memory, pc);
+        }
+        selectBank();
+    }
+
+    CpuState& state() { return cpu; }
+    const CpuState& state() const { return cpu; }
+    const DecodedInstruction& decodedAt(uint8_t pc) const {
+        return tables[bankBase + pc];
+    }
+
+    CpuSnapshot snapshot() const {
+        return {cpu.registers,   cpu.accumulator,  cpu.pc,    cpu.inputPorts,
+                cpu.outputPorts, cpu.instructions, cpu.cycles};
+    }
+
+    // Returns to a snapshot of this program. The journal describes the
+    // path to the old state, so it is cleared.
+    void restore(const CpuSnapshot& snapshot) {
+        cpu.registers = snapshot.registers;
+        cpu.accumulator = snapshot.accumulator;
+        cpu.pc = snapshot.pc;
+        cpu.inputPorts = snapshot.inputPorts;
+        cpu.outputPorts = snapshot.outputPorts;
+        cpu.instructions = snapshot.instructions;
+        cpu.cycles = snapshot.cycles;
+        journal.clear();
+        selectBank();
+    }
+
+    // From now on, runs keep undo records of up to capacity instructions
+    // for stepBack (0 turns the journal off). Changes made through
+    // state() are not recorded.
+    void setJournalCapacity(size_t capacity) {
+        journal = UndoJournal(capacity);
+    }
+    const UndoJournal& getJournal() const { return journal; }
+
+    // Streams a port through ring instead of the latched value: IN takes
+    // the next byte, OUT appends one, and the latch follows. An IN on an
+    // empty ring or an OUT on a full one stops the run with PORT_BLOCKED
+    // and the PC on it, not retired. nullptr goes back to the latch.
+    void attachInput(uint8_t port, PortRing* ring) {
+        inputRings.at(port) = ring;
+    }
+    void attachOutput(uint8_t port, PortRing* ring) {
+        outputRings.at(port) = ring;
+    }
+
+    size_t banks() const { return bankCount; }
+
+    // Undoes the newest recorded instruction, counters included. False
+    // when the journal has no more records. An IN or OUT through a ring is
+    // not undone exactly: the register or latch comes back, but the ring
+    // keeps the byte moved and an IN leaves its input latch as read. An
+    // OUT to the bank port is exact, as the bank follows its latch.
+    bool stepBack() {
+        std::optional<UndoJournal::Entry> entry = journal.pop();
+        if (!entry)
+            return false;
+        if (entry->target < UndoJournal::accumulatorTarget)
+            cpu.registers[entry->target] = entry->old;
+        else if (entry->target == UndoJournal::accumulatorTarget)
+            cpu.accumulator = entry->old;
+        else if (entry->target != UndoJournal::noTarget)
+            cpu.outputPorts[entry->target - UndoJournal::outputPortTarget] =
+                entry->old;
+        selectBank();
+        cpu.pc = entry->pc;
+        cpu.instructions--;
+        cpu.cycles -= decodedAt(entry->pc).length;
+        return true;
+    }
+
+    // Runs until HLT, an undecodable instruction or maxInstructions
+    // executed instructions (0 means no limit). The PC is left on the
+    // instruction that stopped execution.
+    StopReason run(uint64_t maxInstructions = 0) {
+        if (journal.capacity() > 0)
+            return execute<false, true>(maxInstructions, nullptr);
+        return execute<false, false>(maxInstructions, nullptr);
+    }
+
+    // Same as run, also adding every executed instruction and every JFZ
+    // taken to profile. A separate instantiation, so run() pays nothing.
+    StopReason profile(ExecutionProfile& profile,
+                       uint64_t maxInstructions = 0) {
+        if (journal.capacity() > 0)
+            return execute<true, true>(maxInstructions, &profile);
+        return execute<true, false>(maxInstructions, &profile);
+    }
+
+  private:
+    // Shows the bank the bank port's latch names, or bank 0 while it names
+    // none (only a state() edit can do that).
+    void selectBank() {
+        size_t bank = 0;
+        if (bankPort != noBankPort && cpu.outputPorts[bankPort] < bankCount)
+            bank = cpu.outputPorts[bankPort];
+        size_t size = cpu.memory.size();
+        bankBase = bank * size;
+        std::copy_n(image.begin() + bank * size, size, cpu.memory.begin());
+    }
+
+    // The undo record for inst at pc, taken before it executes. acc is
+    // passed in because execute keeps it out of cpu while running.
+    UndoJournal::Entry undoEntry(uint8_t pc,
+                                 const DecodedInstruction& inst,
+                                 uint8_t acc) const {
+        switch (inst.op) {
+            case OP_LDA:
+            case OP_MV_TO_ACC:
+            case OP_ADD_ACC:
+            case OP_SUB_ACC:
+            case OP_INC:
+            case OP_DEC:
+                return {pc, UndoJournal::accumulatorTarget, acc};
+            case OP_MV_ACC:
+            case OP_MV_REG:
+            case OP_MV_IMM:
+            case OP_ADD_IMM:
+            case OP_SUB_IMM:
+            case OP_IN:
+                return {pc, inst.x, cpu.registers[inst.x]};
+            case OP_ADD_REG:
+            case OP_SUB_REG:
+                return {pc, inst.y, cpu.registers[inst.y]};
+            case OP_OUT:
+                return {pc, uint8_t(UndoJournal::outputPortTarget + inst.y),
+                        cpu.outputPorts[inst.y]};
+            default:
+                return {pc, UndoJournal::noTarget, 0};
+        }
+    }
+
+    template <bool profiling, bool journaling>
+    StopReason execute(uint64_t maxInstructions, ExecutionProfile* profile) {
+        uint64_t remaining = maxInstructions == 0 ? UINT64_MAX : maxInstructions;
+        uint8_t pc = cpu.pc;
+        uint8_t acc = cpu.accumulator;
+        uint8_t* r = cpu.registers.data();
+        uint64_t executed = 0;
+        uint64_t cycles = 0;
+        const DecodedInstruction* table = &tables[bankBase];
+        const DecodedInstruction* inst = nullptr;
+        StopReason reason;
+
+#if defined(__GNUC__)
+        // Threaded dispatch: every handler jumps straight to the next one.
+        static void* const handlers[MICRO_OP_COUNT] = {
+            &&op_nop,     &&op_lda,     &&op_mv_acc,  &&op_mv_to_acc,
+            &&op_mv_reg,  &&op_mv_imm,  &&op_add_acc, &&op_add_reg,
+            &&op_add_imm, &&op_sub_acc, &&op_sub_reg, &&op_sub_imm,
+            &&op_inc,     &&op_dec,     &&op_jmp_acc, &&op_jmp_reg,
+            &&op_jfz_acc, &&op_jfz_reg, &&op_in,      &&op_out,
+            &&op_hlt,     &&op_illegal};
+#define ASMZ_CASE(label, op) label:
+#define ASMZ_DISPATCH()                                  \
+    do {                                                 \
+        if (remaining-- == 0)                            \
+            goto step_limit;                             \
+        inst = &table[pc];                               \
+        if constexpr (profiling)                         \
+            profile->executions[pc]++;                   \
+        if constexpr (journaling)                        \
+            if (inst->op != OP_ILLEGAL)                  \
+                journal.push(undoEntry(pc, *inst, acc)); \
+        executed++;                                      \
+        cycles += inst->length;                          \
+        pc += inst->length;                              \
+        goto* handlers[inst->op];                        \
+    } while (0)
+#define ASMZ_NEXT() ASMZ_DISPATCH()
+        ASMZ_DISPATCH();
+#else
+#define ASMZ_CASE(label, op) case op:
+#define ASMZ_NEXT() continue
+        for (;;) {
+            if (remaining-- == 0)
+                goto step_limit;
+            inst = &table[pc];
+            if constexpr (profiling)
+                profile->executions[pc]++;
+            if constexpr (journaling)
+                if (inst->op != OP_ILLEGAL)
+                    journal.push(undoEntry(pc, *inst, acc));
+            executed++;
+            cycles += inst->length;
+            pc += inst->length;
+            switch (inst->op) {
+#endif
+        ASMZ_CASE(op_nop, OP_NOP)
+        ASMZ_NEXT();
+        ASMZ_CASE(op_lda, OP_LDA)
+        acc = inst->immediate;
+        ASMZ_NEXT();
+        ASMZ_CASE(op_mv_acc, OP_MV_ACC)
+        r[inst->x] = acc;
+        ASMZ_NEXT();
+        ASMZ_CASE(op_mv_to_acc, OP_MV_TO_ACC)
+        acc = r[inst->x];
+        ASMZ_NEXT();
+        ASMZ_CASE(op_mv_reg, OP_MV_REG)
+        r[inst->x] = r[inst->y];
+        ASMZ_NEXT();
+        ASMZ_CASE(op_mv_imm, OP_MV_IMM)
+        r[inst->x] = inst->immediate;
+        ASMZ_NEXT();
+        ASMZ_CASE(op_add_acc, OP_ADD_ACC)
+        acc += r[inst->x];
+        ASMZ_NEXT();
+        ASMZ_CASE(op_add_reg, OP_ADD_REG)
+        r[inst->y] += r[inst->x];
+        ASMZ_NEXT();
+        ASMZ_CASE(op_add_imm, OP_ADD_IMM)
+        r[inst->x] += inst->immediate;
+        ASMZ_NEXT();
+        ASMZ_CASE(op_sub_acc, OP_SUB_ACC)
+        acc -= r[inst->x];
+        ASMZ_NEXT();
+        ASMZ_CASE(op_sub_reg, OP_SUB_REG)
+        r[inst->y] -= r[inst->x];
+        ASMZ_NEXT();
+        ASMZ_CASE(op_sub_imm, OP_SUB_IMM)
+        r[inst->x] -= inst->immediate;
+        ASMZ_NEXT();
+        ASMZ_CASE(op_inc, OP_INC)
+        acc++;
+        ASMZ_NEXT();
+        ASMZ_CASE(op_dec, OP_DEC)
+        acc--;
+        ASMZ_NEXT();
+        ASMZ_CASE(op_jmp_acc, OP_JMP_ACC)
+        pc = acc;
+        ASMZ_NEXT();
+        ASMZ_CASE(op_jmp_reg, OP_JMP_REG)
+        pc = r[inst->x];
+        ASMZ_NEXT();
+        ASMZ_CASE(op_jfz_acc, OP_JFZ_ACC)
+        if (acc == 0) {
+            pc = r[inst->x];
+            if constexpr (profiling)
+                profile->taken[inst - table]++;
+        }
+        ASMZ_NEXT();
+        ASMZ_CASE(op_jfz_reg, OP_JFZ_REG)
+        if (r[inst->y] == 0) {
+            pc = r[inst->x];
+            if constexpr (profiling)
+                profile->taken[inst - table]++;
+        }
+        ASMZ_NEXT();
+        ASMZ_CASE(op_in, OP_IN)
+        if (PortRing* ring = inputRings[inst->y]) {
+            if (!ring->pop(cpu.inputPorts[inst->y])) {
+                reason = StopReason::PORT_BLOCKED;
+                goto stop;
+            }
+        }
+        r[inst->x] = cpu.inputPorts[inst->y];
+        ASMZ_NEXT();
+        ASMZ_CASE(op_out, OP_OUT)
+        if (inst->y == bankPort && r[inst->x] >= bankCount) {
+            reason = StopReason::ILLEGAL_INSTRUCTION;
+            goto stop;
+        }
+        if (PortRing* ring = outputRings[inst->y]) {
+            if (!ring->push(r[inst->x])) {
+                reason = StopReason::PORT_BLOCKED;
+                goto stop;
+            }
+        }
+        cpu.outputPorts[inst->y] = r[inst->x];
+        if (inst->y == bankPort) {
+            selectBank();
+            table = &tables[bankBase];
+        }
+        ASMZ_NEXT();
+        ASMZ_CASE(op_hlt, OP_HLT)
+        reason = StopReason::HALTED;
+        goto stop;
+        ASMZ_CASE(op_illegal, OP_ILLEGAL)
+        reason = StopReason::ILLEGAL_INSTRUCTION;
+        goto stop;
+#if !defined(__GNUC__)
+                default:
+                    reason = StopReason::ILLEGAL_INSTRUCTION;
+                    goto stop;
+            }
+        }
+#endif
+#undef ASMZ_CASE
+#undef ASMZ_NEXT
+#undef ASMZ_DISPATCH
+
+    step_limit:
+        cpu.pc = pc;
+        cpu.accumulator = acc;
+        cpu.instructions += executed;
+        cpu.cycles += cycles;
+        return StopReason::STEP_LIMIT;
+
+    stop:
+        // The stopping instruction was counted as executed but only HLT
+        // retires; rewind so a resumed run faults or waits again.
+        if (reason != StopReason::HALTED) {
+            executed--;
+            cycles -= inst->length;
+            if constexpr (profiling)
+                profile->executions[inst - table]--;
+            if constexpr (journaling)
+                if (inst->op != OP_ILLEGAL)
+                    journal.cancel();
+        }
+        cpu.pc = pc - inst->length;
+        cpu.accumulator = acc;
+        cpu.instructions += executed;
+        cpu.cycles += cycles;
+        return reason;
+    }
+
+  public:
+    // Runs the program and describes the final state and the host speed,
+    // the way both command line tools print it.
+    std::string runAndReport(uint64_t maxInstructions = 0) {
+        auto start = std::chrono::steady_clock::now();
+        StopReason reason = run(maxInstructions);
+        return report(cpu, reason, std::chrono::steady_clock::now() - start);
+    }
+
+    static std::string report(const CpuState& cpu,
+                              StopReason reason,
+                              std::chrono::duration<double> elapsed) {
+        std::ostringstream out;
+        out << "Stopped: " << stopReasonNames[int(reason)] << " at PC "
+            << hexByte(cpu.pc) << "\n";
+        out << "Instructions: " << cpu.instructions
+            << ", cycles: " << cpu.cycles << ", time: " << elapsed.count()
+            << " s";
+        if (elapsed.count() > 0)
+            out << ", " << cpu.instructions / elapsed.count() / 1e6 << " MIPS";
+        out << "\nA=" << hexByte(cpu.accumulator);
+        for (size_t i = 0; i < cpu.registers.size(); i++)
+            out << " R" << i << "=" << hexByte(cpu.registers[i]);
+        out << "\nOUT:";
+        for (uint8_t value : cpu.outputPorts)
+            out << " " << hexByte(value);
+        out << "\n";
+        return out.str();
+    }
+
+  private:
+    static std::string hexByte(uint8_t value) {
+        const char* digits = "0123456789abcdef";
+        return {digits[value >> 4], digits[value & 0xF]};
+    }
+};
+
+#endif  // EMULATOR_HPP
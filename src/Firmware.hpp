@@ -0,0 +1,111 @@
+#ifndef FIRMWARE_HPP
+#define FIRMWARE_HPP
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include "CompilerConfig.hpp"
+#include "Lexer.hpp"
+
+struct Firmware {
+    std::array<uint8_t, 256> bytes{};
+    size_t size = 0;
+
+    constexpr std::span<const uint8_t> image() const {
+        return {bytes.data(), size};
+    }
+};
+
+// Assembles AsmZ source while compiling C++, so tests can embed firmware as
+// a constant:
+//
+//     constexpr Firmware blink = assembleFirmware("LDA 01\nloop: INC\n...");
+//
+// It shares the lexer, registry and encoders with Translator and accepts
+// the same syntax, labels included. Any error in the source is a compile
+// error whose message names the problem.
+consteval Firmware assembleFirmware(std::string_view source) {
+    struct Label {
+        std::string_view name;
+        size_t address = 0;
+    };
+    struct Fixup {
+        std::string_view name;
+        size_t offset = 0;
+    };
+    std::array<Label, 64> labels{};
+    size_t labelCount = 0;
+    std::array<Fixup, 128> fixups{};
+    size_t fixupCount = 0;
+
+    Firmware firmware;
+    TokenList tokens;
+    size_t lineNumber = 0;
+    while (!source.empty()) {
+        size_t end = source.find('\n');
+        Lexer::tokenize(source.substr(0, end), ++lineNumber, tokens);
+        source.remove_prefix(end == source.npos ? source.size() : end + 1);
+
+        size_t first = 0;
+        if (!tokens.empty() && tokens[0].text.ends_with(':')) {
+            std::string_view name = tokens[0].text;
+            name.remove_suffix(1);
+            if (!Operand::isSymbolName(name))
+                throw "Invalid label name";
+            for (size_t i = 0; i < labelCount; i++)
+                if (labels[i].name == name)
+                    throw "Label is already defined";
+            if (labelCount == labels.size())
+                throw "Too many labels";
+            labels[labelCount++] = {name, firmware.size};
+            first = 1;
+        }
+        if (tokens.size() <= first)
+            continue;
+
+        const CommandDescriptor* command =
+            CompilerConfig::commands.findByName(tokens[first].text,
+                                                tokens.size() - first - 1);
+        if (command == nullptr)
+            throw "No such instruction";
+
+        std::array<Operand, 2> operands{};
+        for (size_t i = 0; i < command->opcount; i++) {
+            operands[i] = Operand(tokens[first + 1 + i].text);
+            if ((operands[i].type & command->suitableOperandTypes[i]) == 0)
+                throw "Wrong argument type";
+        }
+        if (!command->accepts({operands.data(), command->opcount}))
+            throw "Wrong argument type";
+
+        Encoding encoding =
+            command->encode({operands.data(), command->opcount});
+        if (firmware.size + encoding.size > firmware.bytes.size())
+            throw "Program does not fit into 256 bytes";
+        for (size_t i = 0; i < encoding.size; i++)
+            firmware.bytes[firmware.size++] = encoding.bytes[i];
+
+        for (size_t i = 0; i < command->opcount; i++) {
+            if (operands[i].symbol.empty())
+                continue;
+            if (encoding.size < 2 || fixupCount == fixups.size())
+                throw "Label cannot be used here";
+            fixups[fixupCount++] = {operands[i].symbol, firmware.size - 1};
+        }
+    }
+
+    for (size_t i = 0; i < fixupCount; i++) {
+        size_t label = 0;
+        while (label < labelCount && labels[label].name != fixups[i].name)
+            label++;
+        if (label == labelCount)
+            throw "Undefined label";
+        if (labels[label].address > 0xFF)
+            throw "Label does not fit into 8 bits";
+        firmware.bytes[fixups[i].offset] = labels[label].address;
+    }
+    return firmware;
+}
+
+#endif  // FIRMWARE_HPP
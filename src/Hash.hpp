@@ -0,0 +1,44 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+struct Hash {
+    // FNV-1a, for small keys that have to be hashed at compile time.
+    static constexpr uint64_t fnv1a(std::string_view data,
+                                    uint64_t hash = 0xcbf29ce484222325ull) {
+        for (char c : data) {
+            hash ^= (unsigned char)c;
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    static constexpr uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        value ^= value >> 33;
+        return value;
+    }
+
+    // Word-at-a-time hash for whole source files: eight bytes per multiply
+    // instead of FNV's one, with a murmur-style finalizer.
+    static uint64_t bytes(std::string_view data, uint64_t seed = 0) {
+        uint64_t hash = seed ^ (data.size() * 0x9E3779B97F4A7C15ull);
+        size_t i = 0;
+        for (; i + 8 <= data.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data.data() + i, sizeof(word));
+            hash = (hash ^ mix(word)) * 0x9E3779B97F4A7C15ull;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, data.data() + i, data.size() - i);
+        return mix(hash ^ mix(tail));
+    }
+};
+
+#endif  // HASH_HPP
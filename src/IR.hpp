@@ -0,0 +1,190 @@
+#ifndef IR_HPP
+#define IR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "Commands.hpp"
+#include "Lexer.hpp"
+#include "Types.hpp"
+
+// A table stored column by column in a single allocation: column I of
+// row n is column<I>()[n]. Growing doubles the capacity and moves every
+// column into one new block, so rows are appended without a per-row
+// allocation and passes that read one or two columns stream through
+// contiguous memory.
+template <typename... Types>
+class Columns {
+    static_assert((std::is_trivially_copyable_v<Types> && ...));
+    static constexpr size_t count = sizeof...(Types);
+
+    std::unique_ptr<std::byte[]> storage;
+    std::array<std::byte*, count> columns{};
+    size_t rows = 0;
+    size_t capacity = 0;
+
+    void grow() {
+        size_t grown = capacity == 0 ? 64 : capacity * 2;
+        std::array<size_t, count> offsets;
+        size_t total = 0;
+        size_t index = 0;
+        ((total = (total + alignof(Types) - 1) / alignof(Types) *
+                  alignof(Types),
+          offsets[index++] = total, total += sizeof(Types) * grown),
+         ...);
+
+        std::unique_ptr<std::byte[]> block(new std::byte[total]);
+        index = 0;
+        ((rows == 0 ? void() : void(std::memcpy(block.get() + offsets[index],
+                                                  columns[index],
+                                                  sizeof(Types) * rows)),
+          index++),
+         ...);
+        for (size_t i = 0; i < count; i++)
+            columns[i] = block.get() + offsets[i];
+        storage = std::move(block);
+        capacity = grown;
+    }
+
+    template <size_t... I>
+    void store(std::index_sequence<I...>, const Types&... values) {
+        ((column<I>()[rows] = values), ...);
+    }
+
+  public:
+    template <size_t I>
+    auto* column() {
+        using Type = std::tuple_element_t<I, std::tuple<Types...>>;
+        return reinterpret_cast<Type*>(columns[I]);
+    }
+    template <size_t I>
+    const auto* column() const {
+        using Type = std::tuple_element_t<I, std::tuple<Types...>>;
+        return reinterpret_cast<const Type*>(columns[I]);
+    }
+
+    size_t size() const { return rows; }
+    bool empty() const { return rows == 0; }
+    // Keeps the allocation for the next program.
+    void clear() { rows = 0; }
+
+    size_t push(const Types&... values) {
+        if (rows == capacity)
+            grow();
+        store(std::index_sequence_for<Types...>(), values...);
+        return rows++;
+    }
+};
+
+// A parsed program: one row per statement in source order, plus tables of
+// label definitions and of the statements that use a label. A row holds
+// the command, its operands as kind and value bytes for the passes that
+// inspect them, and the encoding made once at parse time, so layout only
+// copies bytes. Each row keeps its line number for the line table; full
+// source positions are kept only for label references, the one error left
+// after parsing. Passes remove statements by clearing their live flag
+// instead of erasing rows.
+class Program {
+    enum Flags : uint8_t { LIVE = 1, SYMBOLIC = 2 };
+
+    enum { COMMAND, ENCODING, KINDS, VALUES, FLAGS, LINE };
+    Columns<uint8_t,  // index into builtinCommands
+            Encoding,
+            std::array<uint8_t, 2>,
+            std::array<uint8_t, 2>,
+            uint8_t,
+            uint32_t>
+        statements;
+
+    enum { LABEL_SYMBOL, LABEL_STATEMENT };
+    Columns<uint32_t, uint32_t> labels;
+
+    enum { REFERENCE_STATEMENT, REFERENCE_SYMBOL, REFERENCE_LINE,
+           REFERENCE_COLUMN };
+    Columns<uint32_t, uint32_t, uint32_t, uint32_t> references;
+
+    static uint8_t commandIndex(const CommandDescriptor* command) {
+        return std::find(builtinCommands.begin(), builtinCommands.end(),
+                         command) -
+               builtinCommands.begin();
+    }
+
+  public:
+    size_t size() const { return statements.size(); }
+    void clear() {
+        statements.clear();
+        labels.clear();
+        references.clear();
+    }
+
+    void push(const CommandDescriptor* command,
+              const Encoding& encoding,
+              std::span<const Operand> operands,
+              uint32_t line) {
+        std::array<uint8_t, 2> kinds{NONE, NONE};
+        std::array<uint8_t, 2> values{};
+        for (size_t i = 0; i < operands.size() && i < 2; i++) {
+            kinds[i] = operands[i].type;
+            values[i] = operands[i].value;
+        }
+        statements.push(commandIndex(command), encoding, kinds, values, LIVE,
+                        line);
+    }
+
+    // Marks the last statement pushed as patched with symbol's address.
+    void pushReference(uint32_t symbol, SourcePosition position) {
+        statements.column<FLAGS>()[size() - 1] |= SYMBOLIC;
+        references.push(size() - 1, symbol, position.line, position.column);
+    }
+
+    // Marks symbol as defined at the next statement pushed.
+    void pushLabel(uint32_t symbol) { labels.push(symbol, size()); }
+
+    const CommandDescriptor* command(size_t i) const {
+        return builtinCommands[statements.column<COMMAND>()[i]];
+    }
+    const Encoding& encoding(size_t i) const {
+        return statements.column<ENCODING>()[i];
+    }
+    OperandType kind(size_t i, size_t operand) const {
+        return OperandType(statements.column<KINDS>()[i][operand]);
+    }
+    uint8_t value(size_t i, size_t operand) const {
+        return statements.column<VALUES>()[i][operand];
+    }
+    uint32_t line(size_t i) const { return statements.column<LINE>()[i]; }
+    bool live(size_t i) const { return statements.column<FLAGS>()[i] & LIVE; }
+    bool symbolic(size_t i) const {
+        return statements.column<FLAGS>()[i] & SYMBOLIC;
+    }
+    void remove(size_t i) { statements.column<FLAGS>()[i] &= ~LIVE; }
+
+    size_t labelCount() const { return labels.size(); }
+    uint32_t labelSymbol(size_t label) const {
+        return labels.column<LABEL_SYMBOL>()[label];
+    }
+    // Index of the first statement at or after the label.
+    uint32_t labelStatement(size_t label) const {
+        return labels.column<LABEL_STATEMENT>()[label];
+    }
+
+    size_t referenceCount() const { return references.size(); }
+    uint32_t referenceStatement(size_t reference) const {
+        return references.column<REFERENCE_STATEMENT>()[reference];
+    }
+    uint32_t referenceSymbol(size_t reference) const {
+        return references.column<REFERENCE_SYMBOL>()[reference];
+    }
+    SourcePosition referencePosition(size_t reference) const {
+        return {references.column<REFERENCE_LINE>()[reference],
+                references.column<REFERENCE_COLUMN>()[reference]};
+    }
+};
+
+#endif  // IR_HPP
@@ -0,0 +1,407 @@
+#ifndef INCREMENTAL_HPP
+#define INCREMENTAL_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Assembler.hpp"
+#include "SourceFile.hpp"
+
+// Keeps one assembled program in memory as a table of source lines, each
+// with its encoding and address, so an edited version of the source is
+// reassembled by reparsing only the lines that differ. An edit that keeps
+// every line's size and labels is patched into the image in place; any
+// other edit lays the image out again from the first edited line. The image
+// is the one Assembler produces without the optimizer, whose rewrites span
+// lines and have no incremental form. Lines are assembled as written, without
+// the Preprocessor, so directive lines are errors.
+class IncrementalAssembler {
+  public:
+    // What one update touched. Bytes [firstByte, endByte) of the image may
+    // have changed; nothing outside them did.
+    struct Update {
+        size_t firstLine = 0;  // first reparsed line, 1-based; 0: no change
+        size_t removedLines = 0;
+        size_t addedLines = 0;
+        bool relaidOut = false;
+        size_t firstByte = 0;
+        size_t endByte = 0;
+    };
+
+  private:
+    struct Line {
+        Encoding encoding;
+        uint32_t address = 0;  // of the encoding, or of the next one
+        uint32_t labelColumn = 0;
+        uint32_t symbolColumn = 0;
+        std::string label;
+        std::string symbol;  // label patched into the last byte
+    };
+
+    static constexpr size_t compareBlock = 256;
+
+    std::string sourceName;
+    size_t targetSize = 0;
+    Assembler parser;
+    TokenList tokens;
+    Assembler::ParsedLine parsed;
+    Diagnostics diagnostics;
+
+    std::string text;
+    std::vector<uint32_t> lineStarts;
+    std::vector<Line> lines;
+    std::unordered_map<std::string, uint32_t> labels;  // name -> line index
+    std::vector<uint8_t> image;
+    size_t codeSize = 0;
+
+    std::string location(size_t line, size_t column) const {
+        return sourceName + ":" + std::to_string(line + 1) + ":" +
+               std::to_string(column) + ": ";
+    }
+
+    // memcmp over whole blocks finds the edit much faster than a byte loop.
+    static size_t commonPrefix(std::string_view a, std::string_view b) {
+        size_t limit = std::min(a.size(), b.size());
+        size_t i = 0;
+        while (i + compareBlock <= limit &&
+               std::memcmp(a.data() + i, b.data() + i, compareBlock) == 0)
+            i += compareBlock;
+        while (i < limit && a[i] == b[i])
+            i++;
+        return i;
+    }
+
+    static size_t commonSuffix(std::string_view a,
+                               std::string_view b,
+                               size_t limit) {
+        size_t i = 0;
+        while (i + compareBlock <= limit &&
+               std::memcmp(a.end() - i - compareBlock,
+                           b.end() - i - compareBlock, compareBlock) == 0)
+            i += compareBlock;
+        while (i < limit && a[a.size() - 1 - i] == b[b.size() - 1 - i])
+            i++;
+        return i;
+    }
+
+    // Index of the line holding text[offset]; lines.size() past the last
+    // newline.
+    size_t lineAt(size_t offset) const {
+        if (offset == text.size() && (text.empty() || text.back() == '\n'))
+            return lines.size();
+        return std::upper_bound(lineStarts.begin(), lineStarts.end(),
+                                offset) -
+               lineStarts.begin() - 1;
+    }
+
+    static constexpr const char* directivesError =
+        "--watch does not support preprocessor directives!";
+
+    // The word starting with a dot that a line opens with, after its label:
+    // a directive, which only the Preprocessor understands.
+    static const Token* directiveIn(const TokenList& tokens) {
+        size_t at = !tokens.empty() && tokens[0].text.ends_with(':') ? 1 : 0;
+        if (at < tokens.size() && tokens[at].text.starts_with('.'))
+            return &tokens[at];
+        return nullptr;
+    }
+
+    // Parses region, the text of the lines starting at line index first,
+    // into result without touching the current program. Throws with every
+    // error in the region.
+    void parseRegion(std::string_view region,
+                     size_t offset,
+                     size_t first,
+                     std::vector<Line>& result,
+                     std::vector<uint32_t>& starts) {
+        forEachLine(region, [&](std::string_view line, size_t lineNumber) {
+            starts.push_back(offset + (line.data() - region.data()));
+            Line& entry = result.emplace_back();
+            Lexer::tokenize(line, first + lineNumber, tokens);
+            if (tokens.empty())
+                return;
+            if (const Token* directive = directiveIn(tokens)) {
+                if (line.ends_with('\r'))
+                    line.remove_suffix(1);
+                diagnostics.add(directive->position, directive->text,
+                                directivesError, line);
+                return;
+            }
+            if (!parser.parseLine(tokens, parsed)) {
+                const Token& token = tokens[parsed.errorToken];
+                if (line.ends_with('\r'))
+                    line.remove_suffix(1);
+                diagnostics.add(token.position, token.text,
+                                std::move(parsed.error), line);
+                return;
+            }
+            if (!parsed.label.empty()) {
+                entry.label = parsed.label;
+                entry.labelColumn = parsed.labelPosition.column;
+            }
+            if (parsed.command == nullptr)
+                return;
+            entry.encoding = parsed.encoding;
+            if (!parsed.symbol.empty()) {
+                entry.symbol = parsed.symbol;
+                entry.symbolColumn = parsed.symbolPosition.column;
+            }
+        });
+        if (!diagnostics.empty()) {
+            std::string report = diagnostics.report();
+            diagnostics.clear();
+            throw std::runtime_error(report);
+        }
+    }
+
+    uint8_t addressOf(const Line& line, size_t index) const {
+        auto found = labels.find(line.symbol);
+        if (found == labels.end())
+            throw std::runtime_error(location(index, line.symbolColumn) +
+                                     "Undefined label: " + line.symbol + "!");
+        size_t address = lines[found->second].address;
+        if (address > 0xFF)
+            throw std::runtime_error(
+                location(index, line.symbolColumn) + "Label " + line.symbol +
+                " at address " + std::to_string(address) +
+                " does not fit into 8 bits!");
+        return address;
+    }
+
+    void touch(Update& update, size_t begin, size_t end) {
+        if (begin >= end)
+            return;
+        if (update.firstByte >= update.endByte) {
+            update.firstByte = begin;
+            update.endByte = end;
+            return;
+        }
+        update.firstByte = std::min(update.firstByte, begin);
+        update.endByte = std::max(update.endByte, end);
+    }
+
+    // Same sizes and labels: the addresses of every line stay put, so only
+    // the reparsed lines' bytes change.
+    bool patchable(size_t first, const std::vector<Line>& replacement) const {
+        for (size_t i = 0; i < replacement.size(); i++)
+            if (replacement[i].encoding.size !=
+                    lines[first + i].encoding.size ||
+                replacement[i].label != lines[first + i].label)
+                return false;
+        return true;
+    }
+
+    void patch(size_t first,
+               std::vector<Line>& replacement,
+               Update& update) {
+        for (size_t i = 0; i < replacement.size(); i++) {
+            Line& line = replacement[i];
+            line.address = lines[first + i].address;
+            if (!line.symbol.empty())
+                line.encoding.bytes[line.encoding.size - 1] =
+                    addressOf(line, first + i);
+        }
+        for (size_t i = 0; i < replacement.size(); i++) {
+            Line& line = replacement[i];
+            std::copy_n(line.encoding.bytes.begin(), line.encoding.size,
+                        image.begin() + line.address);
+            touch(update, line.address, line.address + line.encoding.size);
+            lines[first + i] = std::move(line);
+        }
+    }
+
+    void relayout(size_t first,
+                  size_t last,
+                  std::vector<Line>& replacement,
+                  Update& update) {
+        size_t end = first + replacement.size();
+        size_t oldEnd = last < lines.size() ? lines[last].address : codeSize;
+        bool labelsMoved = false;
+        for (size_t i = first; i < last; i++)
+            if (!lines[i].label.empty()) {
+                labels.erase(lines[i].label);
+                labelsMoved = true;
+            }
+        if (end != last)
+            for (auto& [name, index] : labels)
+                if (index >= last)
+                    index = index - last + end;
+
+        lines.erase(lines.begin() + first, lines.begin() + last);
+        lines.insert(lines.begin() + first,
+                     std::make_move_iterator(replacement.begin()),
+                     std::make_move_iterator(replacement.end()));
+
+        for (size_t i = first; i < end; i++) {
+            if (lines[i].label.empty())
+                continue;
+            labelsMoved = true;
+            auto [found, added] = labels.emplace(lines[i].label, i);
+            if (added)
+                continue;
+            // Reported at the later definition, as a full assembly does.
+            size_t earlier = std::min<size_t>(found->second, i);
+            size_t later = std::max<size_t>(found->second, i);
+            throw std::runtime_error(
+                location(later, lines[later].labelColumn) + "Label " +
+                lines[i].label + " is already defined at line " +
+                std::to_string(earlier + 1) + "!");
+        }
+
+        size_t address =
+            first == 0 ? 0
+                       : lines[first - 1].address +
+                             lines[first - 1].encoding.size;
+        for (size_t i = first; i < end; i++) {
+            lines[i].address = address;
+            address += lines[i].encoding.size;
+        }
+        bool shifted = address != oldEnd;
+        size_t written = end;
+        if (shifted) {
+            for (; written < lines.size(); written++) {
+                lines[written].address = address;
+                address += lines[written].encoding.size;
+            }
+            codeSize = address;
+        }
+
+        image.resize(codeSize);
+        for (size_t i = first; i < written; i++)
+            std::copy_n(lines[i].encoding.bytes.begin(),
+                        lines[i].encoding.size,
+                        image.begin() + lines[i].address);
+        if (first < written)
+            touch(update, lines[first].address,
+                  shifted ? codeSize
+                          : lines[written - 1].address +
+                                lines[written - 1].encoding.size);
+
+        // Moved labels change references anywhere in the program.
+        size_t from = shifted || labelsMoved ? 0 : first;
+        size_t to = shifted || labelsMoved ? lines.size() : end;
+        for (size_t i = from; i < to; i++) {
+            const Line& line = lines[i];
+            if (line.symbol.empty())
+                continue;
+            size_t offset = line.address + line.encoding.size - 1;
+            uint8_t value = addressOf(line, i);
+            if (image[offset] != value || (i >= first && i < end)) {
+                image[offset] = value;
+                touch(update, offset, offset + 1);
+            }
+        }
+
+        if (targetSize != 0) {
+            if (codeSize > targetSize)
+                throw std::runtime_error(
+                    "Source code is too big to be compiled to file of size: " +
+                    std::to_string(targetSize));
+            image.resize(targetSize, 0);
+        }
+    }
+
+    void clear() {
+        text.clear();
+        lineStarts.clear();
+        lines.clear();
+        labels.clear();
+        image.clear();
+        codeSize = 0;
+    }
+
+  public:
+    // A nonzero targetSize zero-pads the image to that size, like
+    // --binary-size.
+    explicit IncrementalAssembler(std::string sourceName = "<memory>",
+                                  size_t targetSize = 0)
+        : sourceName(sourceName),
+          targetSize(targetSize),
+          diagnostics(sourceName) {}
+
+    // Assembles source from scratch.
+    Update load(std::string source) {
+        clear();
+        return update(std::move(source));
+    }
+
+    // Reassembles after the source changed to source. On error the previous
+    // program is kept and the next update is diffed against it.
+    Update update(std::string source) {
+        Update result;
+        size_t prefix = commonPrefix(text, source);
+        if (prefix == text.size() && prefix == source.size())
+            return result;
+        size_t suffix = commonSuffix(
+            text, source, std::min(text.size(), source.size()) - prefix);
+
+        // The edit spans from the line holding the first changed byte to
+        // the first line whose preceding newline is in the common suffix.
+        size_t first = lineAt(prefix);
+        size_t last = std::upper_bound(lineStarts.begin(), lineStarts.end(),
+                                       text.size() - suffix) -
+                      lineStarts.begin();
+        size_t begin = first < lines.size() ? lineStarts[first] : text.size();
+        size_t oldEnd = last < lines.size() ? lineStarts[last] : text.size();
+        size_t newEnd = source.size() - (text.size() - oldEnd);
+
+        std::vector<Line> replacement;
+        std::vector<uint32_t> starts;
+        parseRegion(std::string_view(source).substr(begin, newEnd - begin),
+                    begin, first, replacement, starts);
+        result.firstLine = first + 1;
+        result.removedLines = last - first;
+        result.addedLines = replacement.size();
+
+        if (replacement.size() == last - first &&
+            patchable(first, replacement)) {
+            patch(first, replacement, result);
+        } else {
+            result.relaidOut = true;
+            try {
+                relayout(first, last, replacement, result);
+            } catch (const std::runtime_error&) {
+                // The text is still the previous source: rebuild from it.
+                std::string previous = std::move(text);
+                clear();
+                update(std::move(previous));
+                throw;
+            }
+        }
+
+        lineStarts.erase(lineStarts.begin() + first,
+                         lineStarts.begin() + last);
+        lineStarts.insert(lineStarts.begin() + first, starts.begin(),
+                          starts.end());
+        if (source.size() != text.size())
+            for (size_t i = first + starts.size(); i < lineStarts.size(); i++)
+                lineStarts[i] += source.size() - text.size();
+        text = std::move(source);
+        return result;
+    }
+
+    const std::vector<uint8_t>& getImage() const { return image; }
+    size_t lineCount() const { return lines.size(); }
+
+    // Throws "name:line: ..." for the first directive line in source, so a
+    // caller can refuse such a file before it starts updating.
+    static void rejectDirectives(std::string_view source,
+                                 const std::string& name) {
+        TokenList tokens;
+        forEachLine(source, [&](std::string_view line, size_t lineNumber) {
+            Lexer::tokenize(line, lineNumber, tokens);
+            if (directiveIn(tokens) != nullptr)
+                throw std::runtime_error(name + ":" +
+                                         std::to_string(lineNumber) + ": " +
+                                         directivesError);
+        });
+    }
+};
+
+#endif  // INCREMENTAL_HPP
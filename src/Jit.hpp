@@ -0,0 +1,496 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+#include "Emulator.hpp"
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define ASMZ_HAS_JIT 1
+#include <sys/mman.h>
+#endif
+
+// Runs AsmZ programs by translating each basic block to x86-64 code the
+// first time execution reaches it. Blocks are cached by start address and
+// jump to each other through a 256-entry table indexed by guest PC, so
+// the guest registers stay in host registers between blocks:
+//
+//     Acc -> al, R0-R7 -> bl, bpl, sil, dil, r8b, r12b, r13b, r14b
+//     rcx/rdx scratch, r9 instructions left, r10 CpuState*, r11 the table,
+//     r15 cycles
+//
+// Everything the translated code cannot handle exactly is left to the
+// interpreter: undecodable instructions, blocks longer than the remaining
+// instruction budget, and the whole program on hosts without the JIT or
+// where executable memory cannot be mapped. Results, counters included,
+// match Emulator::run instruction for instruction.
+class JitEmulator {
+    Emulator interpreter;
+
+#if ASMZ_HAS_JIT
+    struct Exit {
+        uint64_t remaining;
+        uint64_t reason;
+    };
+    enum ExitReason : uint32_t { EXIT_INTERPRET, EXIT_HALTED };
+    using Entry = Exit (*)(CpuState* cpu, void* const* table, uint64_t remaining);
+
+    enum HostRegister : uint8_t {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15
+    };
+    static constexpr uint8_t accumulator = RAX;
+    static constexpr std::array<uint8_t, 8> guest = {RBX, RBP, RSI, RDI,
+                                                     R8,  R12, R13, R14};
+
+    static constexpr size_t codeCapacity = 1 << 20;
+    static constexpr size_t maxBlockInstructions = 32;
+
+    uint8_t* code = nullptr;
+    size_t codeSize = 0;
+    Entry entry = nullptr;
+    const uint8_t* exitStub = nullptr;
+    const uint8_t* missStub = nullptr;
+
+    std::array<void*, 256> table{};
+    std::array<uint8_t, 256> blockLength{};  // instructions, 0 = interpret
+    std::array<bool, 256> translated{};
+
+    // Machine code for one routine, placed at a known address so relative
+    // jumps can be resolved while emitting.
+    class CodeBuffer {
+        std::vector<uint8_t> bytes;
+        const uint8_t* base;
+
+      public:
+        explicit CodeBuffer(const uint8_t* base) : base(base) {}
+
+        const std::vector<uint8_t>& data() const { return bytes; }
+        size_t size() const { return bytes.size(); }
+
+        void byte(uint8_t value) { bytes.push_back(value); }
+        void dword(uint32_t value) {
+            for (int i = 0; i < 4; i++)
+                byte(value >> (8 * i));
+        }
+
+        // Byte registers always get a REX prefix, which selects sil, dil
+        // and bpl rather than dh, bh and ch.
+        void rex(bool wide, uint8_t reg, uint8_t rm) {
+            byte(0x40 | wide << 3 | (reg >> 3) << 2 | (rm >> 3));
+        }
+        void modrm(uint8_t mod, uint8_t reg, uint8_t rm) {
+            byte(mod << 6 | (reg & 7) << 3 | (rm & 7));
+        }
+
+        // opcode r/m8, r8 (mov 88, add 00, sub 28, test 84)
+        void op8(uint8_t opcode, uint8_t rm, uint8_t reg) {
+            rex(false, reg, rm);
+            byte(opcode);
+            modrm(3, reg, rm);
+        }
+        // 80 /extension r/m8, imm8 (add 0, sub 5)
+        void op8Imm(uint8_t extension, uint8_t rm, uint8_t immediate) {
+            rex(false, 0, rm);
+            byte(0x80);
+            modrm(3, extension, rm);
+            byte(immediate);
+        }
+        void movImm8(uint8_t reg, uint8_t immediate) {
+            rex(false, 0, reg);
+            byte(0xB0 + (reg & 7));
+            byte(immediate);
+        }
+        // FE /extension r/m8 (inc 0, dec 1)
+        void incDec8(uint8_t extension, uint8_t rm) {
+            rex(false, 0, rm);
+            byte(0xFE);
+            modrm(3, extension, rm);
+        }
+        // Loads (8A) or stores (88) a byte at [r10 + offset].
+        void state8(uint8_t opcode, uint8_t reg, size_t offset) {
+            rex(false, reg, R10);
+            byte(opcode);
+            modrm(2, reg, R10);
+            dword(offset);
+        }
+        // Loads (8B) or stores (89) a quadword at [r10 + offset].
+        void state64(uint8_t opcode, uint8_t reg, size_t offset) {
+            rex(true, reg, R10);
+            byte(opcode);
+            modrm(2, reg, R10);
+            dword(offset);
+        }
+        void mov64(uint8_t to, uint8_t from) {
+            rex(true, from, to);
+            byte(0x89);
+            modrm(3, from, to);
+        }
+        // 81 /extension r/m64, imm32 (add 0, sub 5, cmp 7)
+        void op64(uint8_t extension, uint8_t rm, uint32_t immediate) {
+            rex(true, 0, rm);
+            byte(0x81);
+            modrm(3, extension, rm);
+            dword(immediate);
+        }
+        void movzxEcx(uint8_t reg) {
+            rex(false, RCX, reg);
+            byte(0x0F);
+            byte(0xB6);
+            modrm(3, RCX, reg);
+        }
+        void movEcx(uint8_t value) {
+            byte(0xB9);
+            dword(value);
+        }
+        void movEdx(uint32_t value) {
+            byte(0xBA);
+            dword(value);
+        }
+        void push(uint8_t reg) {
+            if (reg >= R8)
+                byte(0x41);
+            byte(0x50 + (reg & 7));
+        }
+        void pop(uint8_t reg) {
+            if (reg >= R8)
+                byte(0x41);
+            byte(0x58 + (reg & 7));
+        }
+
+        // jmp [r11 + rcx * 8]
+        void jumpThroughTable() {
+            byte(0x41);
+            byte(0xFF);
+            byte(0x24);
+            byte(0xCB);
+        }
+        void jump(const uint8_t* target) {
+            byte(0xE9);
+            dword(target - (base + size() + 4));
+        }
+        // Conditional jump forward to a label bound later; returns the
+        // position of its displacement for bind().
+        size_t jumpIf(uint8_t condition) {
+            byte(0x0F);
+            byte(0x80 | condition);
+            dword(0);
+            return size() - 4;
+        }
+        void bind(size_t displacement) {
+            uint32_t distance = size() - (displacement + 4);
+            std::memcpy(&bytes[displacement], &distance, 4);
+        }
+    };
+
+    static constexpr uint8_t CONDITION_BELOW = 0x2;
+    static constexpr uint8_t CONDITION_NOT_ZERO = 0x5;
+
+    const uint8_t* install(const CodeBuffer& routine) {
+        if (mprotect(code, codeCapacity, PROT_READ | PROT_WRITE) != 0)
+            return nullptr;
+        std::memcpy(code + codeSize, routine.data().data(), routine.size());
+        const uint8_t* start = code + codeSize;
+        codeSize += routine.size();
+        if (mprotect(code, codeCapacity, PROT_READ | PROT_EXEC) != 0)
+            return nullptr;
+        return start;
+    }
+
+    void emitPrologue() {
+        CodeBuffer a(code + codeSize);
+        for (uint8_t reg : {RBX, RBP, R12, R13, R14, R15})
+            a.push(reg);
+        a.mov64(R10, RDI);
+        a.mov64(R11, RSI);
+        a.mov64(R9, RDX);
+        for (size_t i = 0; i < guest.size(); i++)
+            a.state8(0x8A, guest[i], offsetof(CpuState, registers) + i);
+        a.state8(0x8A, accumulator, offsetof(CpuState, accumulator));
+        a.state64(0x8B, R15, offsetof(CpuState, cycles));
+        // movzx ecx, byte [r10 + pc]
+        a.rex(false, RCX, R10);
+        a.byte(0x0F);
+        a.byte(0xB6);
+        a.modrm(2, RCX, R10);
+        a.dword(offsetof(CpuState, pc));
+        a.jumpThroughTable();
+        entry = reinterpret_cast<Entry>(const_cast<uint8_t*>(install(a)));
+    }
+
+    // Entered with the next guest PC in ecx and the exit reason in edx.
+    void emitExit() {
+        CodeBuffer a(code + codeSize);
+        for (size_t i = 0; i < guest.size(); i++)
+            a.state8(0x88, guest[i], offsetof(CpuState, registers) + i);
+        a.state8(0x88, accumulator, offsetof(CpuState, accumulator));
+        a.state8(0x88, RCX, offsetof(CpuState, pc));
+        a.state64(0x89, R15, offsetof(CpuState, cycles));
+        a.mov64(RAX, R9);
+        for (uint8_t reg : {R15, R14, R13, R12, RBP, RBX})
+            a.pop(reg);
+        a.byte(0xC3);
+        exitStub = install(a);
+
+        CodeBuffer miss(code + codeSize);
+        miss.movEdx(EXIT_INTERPRET);
+        miss.jump(exitStub);
+        missStub = install(miss);
+    }
+
+    static bool endsBlock(MicroOp op) {
+        return op == OP_JMP_ACC || op == OP_JMP_REG || op == OP_JFZ_ACC ||
+               op == OP_JFZ_REG || op == OP_HLT;
+    }
+
+    // Continues at a constant guest address, jumping straight into its
+    // block when that is already translated.
+    void emitGoto(CodeBuffer& a, uint8_t pc) {
+        a.movEcx(pc);
+        if (blockLength[pc] != 0)
+            a.jump(static_cast<const uint8_t*>(table[pc]));
+        else
+            a.jumpThroughTable();
+    }
+
+    void translate(uint8_t start) {
+        translated[start] = true;
+        const CpuState& cpu = interpreter.state();
+
+        struct Step {
+            DecodedInstruction inst;
+            uint8_t pc;
+        };
+        std::vector<Step> steps;
+        uint32_t cycles = 0;
+        uint8_t pc = start;
+        while (steps.size() < maxBlockInstructions) {
+            DecodedInstruction inst = decodeInstruction(cpu.memory, pc);
+            if (inst.op == OP_ILLEGAL)
+                break;
+            steps.push_back({inst, pc});
+            cycles += inst.length;
+            pc += inst.length;
+            if (endsBlock(inst.op))
+                break;
+        }
+        if (steps.empty())
+            return;
+
+        CodeBuffer a(code + codeSize);
+        a.op64(7, R9, steps.size());
+        size_t outOfBudget = a.jumpIf(CONDITION_BELOW);
+        a.op64(5, R9, steps.size());
+        a.op64(0, R15, cycles);
+
+        bool open = true;
+        for (const Step& step : steps) {
+            const DecodedInstruction& inst = step.inst;
+            uint8_t next = step.pc + inst.length;
+            uint8_t x = guest[inst.x];
+            uint8_t y = guest[inst.y];
+            switch (inst.op) {
+                case OP_NOP:
+                    break;
+                case OP_LDA:
+                    a.movImm8(accumulator, inst.immediate);
+                    break;
+                case OP_MV_ACC:
+                    a.op8(0x88, x, accumulator);
+                    break;
+                case OP_MV_TO_ACC:
+                    a.op8(0x88, accumulator, x);
+                    break;
+                case OP_MV_REG:
+                    a.op8(0x88, x, y);
+                    break;
+                case OP_MV_IMM:
+                    a.movImm8(x, inst.immediate);
+                    break;
+                case OP_ADD_ACC:
+                    a.op8(0x00, accumulator, x);
+                    break;
+                case OP_ADD_REG:
+                    a.op8(0x00, y, x);
+                    break;
+                case OP_ADD_IMM:
+                    a.op8Imm(0, x, inst.immediate);
+                    break;
+                case OP_SUB_ACC:
+                    a.op8(0x28, accumulator, x);
+                    break;
+                case OP_SUB_REG:
+                    a.op8(0x28, y, x);
+                    break;
+                case OP_SUB_IMM:
+                    a.op8Imm(5, x, inst.immediate);
+                    break;
+                case OP_INC:
+                    a.incDec8(0, accumulator);
+                    break;
+                case OP_DEC:
+                    a.incDec8(1, accumulator);
+                    break;
+                case OP_JMP_ACC:
+                    a.movzxEcx(accumulator);
+                    a.jumpThroughTable();
+                    open = false;
+                    break;
+                case OP_JMP_REG:
+                    a.movzxEcx(x);
+                    a.jumpThroughTable();
+                    open = false;
+                    break;
+                case OP_JFZ_ACC:
+                case OP_JFZ_REG: {
+                    uint8_t tested = inst.op == OP_JFZ_ACC ? accumulator : y;
+                    a.op8(0x84, tested, tested);
+                    size_t notTaken = a.jumpIf(CONDITION_NOT_ZERO);
+                    a.movzxEcx(x);
+                    a.jumpThroughTable();
+                    a.bind(notTaken);
+                    emitGoto(a, next);
+                    open = false;
+                    break;
+                }
+                case OP_IN:
+                    a.state8(0x8A, x, offsetof(CpuState, inputPorts) + inst.y);
+                    break;
+                case OP_OUT:
+                    a.state8(0x88, x, offsetof(CpuState, outputPorts) + inst.y);
+                    break;
+                case OP_HLT:
+                    a.movEcx(step.pc);
+                    a.movEdx(EXIT_HALTED);
+                    a.jump(exitStub);
+                    open = false;
+                    break;
+                default:
+                    return;
+            }
+        }
+        if (open)
+            emitGoto(a, pc);
+
+        a.bind(outOfBudget);
+        a.movEcx(start);
+        a.movEdx(EXIT_INTERPRET);
+        a.jump(exitStub);
+
+        // Generous bound for the epilogue of the longest block.
+        if (codeSize + a.size() + 64 > codeCapacity)
+            return;
+        const uint8_t* block = install(a);
+        if (block == nullptr)
+            return;
+        table[start] = const_cast<uint8_t*>(block);
+        blockLength[start] = steps.size();
+    }
+
+    void reset() {
+        if (code == nullptr)
+            return;
+        codeSize = 0;
+        emitPrologue();
+        emitExit();
+        if (entry == nullptr || exitStub == nullptr || missStub == nullptr) {
+            munmap(code, codeCapacity);
+            code = nullptr;
+            return;
+        }
+        table.fill(const_cast<uint8_t*>(missStub));
+        blockLength.fill(0);
+        translated.fill(false);
+    }
+#endif
+
+  public:
+    explicit JitEmulator(std::span<const uint8_t> image) : interpreter(image) {
+#if ASMZ_HAS_JIT
+        void* region = mmap(nullptr, codeCapacity, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region != MAP_FAILED)
+            code = static_cast<uint8_t*>(region);
+        reset();
+#endif
+    }
+
+    JitEmulator(const JitEmulator&) = delete;
+    JitEmulator& operator=(const JitEmulator&) = delete;
+
+    ~JitEmulator() {
+#if ASMZ_HAS_JIT
+        if (code != nullptr)
+            munmap(code, codeCapacity);
+#endif
+    }
+
+    void load(std::span<const uint8_t> image) {
+        interpreter.load(image);
+#if ASMZ_HAS_JIT
+        reset();
+#endif
+    }
+
+    // False when every instruction goes through the interpreter.
+    bool compiles() const {
+#if ASMZ_HAS_JIT
+        return code != nullptr;
+#else
+        return false;
+#endif
+    }
+
+    CpuState& state() { return interpreter.state(); }
+    const CpuState& state() const { return interpreter.state(); }
+    CpuSnapshot snapshot() const { return interpreter.snapshot(); }
+    void restore(const CpuSnapshot& snapshot) { interpreter.restore(snapshot); }
+
+    // Same contract as Emulator::run.
+    StopReason run(uint64_t maxInstructions = 0) {
+#if ASMZ_HAS_JIT
+        if (code == nullptr)
+            return interpreter.run(maxInstructions);
+        CpuState& cpu = interpreter.state();
+        uint64_t remaining =
+            maxInstructions == 0 ? UINT64_MAX : maxInstructions;
+        for (;;) {
+            if (remaining == 0)
+                return StopReason::STEP_LIMIT;
+            if (!translated[cpu.pc])
+                translate(cpu.pc);
+            if (blockLength[cpu.pc] != 0 &&
+                remaining >= blockLength[cpu.pc]) {
+                Exit exit = entry(&cpu, table.data(), remaining);
+                cpu.instructions += remaining - exit.remaining;
+                remaining = exit.remaining;
+                if (exit.reason == EXIT_HALTED)
+                    return StopReason::HALTED;
+                continue;
+            }
+            uint64_t before = cpu.instructions;
+            StopReason reason = interpreter.run(1);
+            remaining -= cpu.instructions - before;
+            if (reason != StopReason::STEP_LIMIT)
+                return reason;
+        }
+#else
+        return interpreter.run(maxInstructions);
+#endif
+    }
+
+    std::string runAndReport(uint64_t maxInstructions = 0) {
+        auto start = std::chrono::steady_clock::now();
+        StopReason reason = run(maxInstructions);
+        return Emulator::report(state(), reason,
+                                std::chrono::steady_clock::now() - start);
+    }
+};
+
+#endif  // JIT_HPP
@@ -0,0 +1,71 @@
+#ifndef LEXER_HPP
+#define LEXER_HPP
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+struct SourcePosition {
+    size_t line = 0;
+    size_t column = 0;
+};
+
+struct Token {
+    std::string_view text;
+    SourcePosition position;
+};
+
+// Fixed-capacity token storage reused between lines. Tokens past the
+// capacity are counted but not stored, so an overlong line still reports
+// its real arity and fails the instruction lookup.
+class TokenList {
+    static constexpr size_t capacity = 8;
+    std::array<Token, capacity> tokens;
+    size_t count = 0;
+
+  public:
+    constexpr void clear() { count = 0; }
+    constexpr void push(Token token) {
+        if (count < capacity)
+            tokens[count] = token;
+        count++;
+    }
+
+    constexpr bool empty() const { return count == 0; }
+    constexpr size_t size() const { return count; }
+    constexpr const Token& front() const { return tokens[0]; }
+    constexpr const Token& operator[](size_t index) const {
+        return tokens[index];
+    }
+};
+
+struct Lexer {
+    static constexpr bool isDelimiter(char c) {
+        return c == ' ' || c == ',' || c == '\t' || c == '\r';
+    }
+
+    // Splits one source line into views over the caller's buffer, so the
+    // tokens stay valid only as long as that buffer does.
+    static constexpr void tokenize(std::string_view line,
+                                   size_t lineNumber,
+                                   TokenList& result) {
+        result.clear();
+        size_t comment = line.find("//");
+        if (comment != line.npos)
+            line = line.substr(0, comment);
+
+        size_t i = 0;
+        while (i < line.length()) {
+            while (i < line.length() && isDelimiter(line[i]))
+                i++;
+            size_t start = i;
+            while (i < line.length() && !isDelimiter(line[i]))
+                i++;
+            if (start != i)
+                result.push({line.substr(start, i - start),
+                             {lineNumber, start + 1}});
+        }
+    }
+};
+
+#endif  // LEXER_HPP
@@ -0,0 +1,137 @@
+#ifndef LINETABLE_HPP
+#define LINETABLE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Diagnostics.hpp"
+
+// Which source line each instruction of an image was assembled from.
+// Assembler records every instruction's address with the line number it
+// was fed during layout; Translator then resolves those numbers through the
+// Preprocessor's LineMap into files, lines and the macro expansions they
+// came from. Without resolve() every line belongs to one file under its
+// own number.
+class LineTable {
+  public:
+    struct Entry {
+        uint32_t address = 0;
+        uint32_t size = 0;
+        uint32_t line = 0;
+        uint32_t file = 0;  // index into files
+        int32_t expansion = -1;  // index into expansions, or -1
+    };
+
+    struct Label {
+        uint32_t address = 0;
+        std::string name;
+        uint32_t line = 0;
+        int32_t expansion = -1;  // set for labels defined by a macro
+    };
+
+    struct Expansion {
+        std::string macro;
+        uint32_t file = 0;  // of the invocation
+        uint32_t line = 0;
+        int32_t parent = -1;  // expansion the invocation itself came from
+    };
+
+  private:
+    std::vector<Entry> entries;  // by address, as layout emits them
+    std::vector<Label> labels;  // by address
+    std::vector<std::string> files;
+    std::vector<Expansion> expansions;
+
+  public:
+    explicit LineTable(std::string sourceName = "<memory>")
+        : files{std::move(sourceName)} {}
+
+    void clear() {
+        entries.clear();
+        labels.clear();
+        files.resize(1);
+        expansions.clear();
+    }
+
+    void addInstruction(uint32_t address, uint32_t size, uint32_t line) {
+        entries.push_back({address, size, line});
+    }
+
+    void addLabel(uint32_t address, std::string name, uint32_t line) {
+        labels.push_back({address, std::move(name), line});
+    }
+
+    // Turns the fed line numbers into the places map says they came from.
+    void resolve(const LineMap& map) {
+        std::unordered_map<const std::string*, uint32_t> indices;
+        auto fileIndex = [&](const std::string* file) {
+            auto [found, added] = indices.try_emplace(file, files.size());
+            if (added && *file == files[0])
+                found->second = 0;
+            else if (added)
+                files.push_back(*file);
+            return found->second;
+        };
+        for (size_t i = 0; i < map.expansionCount(); i++) {
+            const LineMap::Expansion& expansion = map.expansion(i);
+            expansions.push_back({expansion.macro,
+                                  fileIndex(expansion.invocation.file),
+                                  uint32_t(expansion.invocation.line),
+                                  expansion.invocation.expansion});
+        }
+        for (Entry& entry : entries) {
+            LineMap::Location location = map.locate(entry.line);
+            if (location.file == nullptr)
+                continue;
+            entry.file = fileIndex(location.file);
+            entry.line = location.line;
+            entry.expansion = location.expansion;
+        }
+        for (Label& label : labels)
+            label.expansion = map.locate(label.line).expansion;
+    }
+
+    size_t size() const { return entries.size(); }
+    const Entry& operator[](size_t index) const { return entries[index]; }
+
+    // The instruction that starts at address, or nullptr.
+    const Entry* find(uint32_t address) const {
+        auto found = std::lower_bound(
+            entries.begin(), entries.end(), address,
+            [](const Entry& entry, uint32_t address) {
+                return entry.address < address;
+            });
+        return found != entries.end() && found->address == address ? &*found
+                                                                   : nullptr;
+    }
+
+    // The last label at or before address that was written in the source
+    // rather than made by a macro, or nullptr.
+    const Label* labelBefore(uint32_t address) const {
+        auto found = std::upper_bound(
+            labels.begin(), labels.end(), address,
+            [](uint32_t address, const Label& label) {
+                return address < label.address;
+            });
+        while (found != labels.begin()) {
+            --found;
+            if (found->expansion < 0)
+                return &*found;
+        }
+        return nullptr;
+    }
+
+    const std::string& file(uint32_t index) const { return files[index]; }
+    const Expansion& expansion(int32_t index) const {
+        return expansions[index];
+    }
+
+    // "file:line".
+    std::string describe(const Entry& entry) const {
+        return files[entry.file] + ":" + std::to_string(entry.line);
+    }
+};
+
+#endif  // LINETABLE_HPP
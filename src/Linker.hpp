@@ -0,0 +1,120 @@
+#ifndef LINKER_HPP
+#define LINKER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ObjectFile.hpp"
+
+// Combines ObjectFiles into one image. Sections with the same name are
+// placed together, in the order the names first appear and, within a name,
+// in the order the objects were added. Each relocation then gets the
+// address of its symbol: a label of the same object, or one exported by
+// exactly one object. Like the assembler, the linker collects every error
+// before it throws.
+class Linker {
+    struct Input {
+        std::string name;
+        ObjectFile object;
+        std::vector<size_t> bases;  // address of every section
+    };
+
+    struct Export {
+        size_t address;
+        size_t input;
+    };
+
+    std::vector<Input> inputs;
+
+  public:
+    void add(std::string name, ObjectFile object) {
+        inputs.push_back({std::move(name), std::move(object), {}});
+    }
+
+    // targetSize pads the image with zeros like --binary-size does for a
+    // single source; 0 leaves it as long as the code.
+    std::vector<uint8_t> link(size_t targetSize = 0) {
+        std::vector<std::string> order;
+        for (const Input& input : inputs)
+            for (const ObjectFile::Section& section : input.object.sections)
+                if (std::find(order.begin(), order.end(), section.name) ==
+                    order.end())
+                    order.push_back(section.name);
+
+        std::vector<uint8_t> image;
+        for (Input& input : inputs)
+            input.bases.assign(input.object.sections.size(), 0);
+        for (const std::string& name : order)
+            for (Input& input : inputs)
+                for (size_t i = 0; i < input.object.sections.size(); i++) {
+                    const ObjectFile::Section& section =
+                        input.object.sections[i];
+                    if (section.name != name)
+                        continue;
+                    input.bases[i] = image.size();
+                    image.insert(image.end(), section.bytes.begin(),
+                                 section.bytes.end());
+                }
+
+        std::vector<std::string> errors;
+        std::unordered_map<std::string, Export> exports;
+        for (size_t i = 0; i < inputs.size(); i++)
+            for (const ObjectFile::Symbol& symbol : inputs[i].object.symbols) {
+                if (!symbol.defined || !symbol.global)
+                    continue;
+                size_t address =
+                    inputs[i].bases[symbol.section] + symbol.offset;
+                auto [found, added] =
+                    exports.try_emplace(symbol.name, Export{address, i});
+                if (!added)
+                    errors.push_back(inputs[i].name + ": label " +
+                                     symbol.name + " is already defined in " +
+                                     inputs[found->second.input].name + "!");
+            }
+
+        for (const Input& input : inputs)
+            for (const ObjectFile::Relocation& relocation :
+                 input.object.relocations) {
+                const ObjectFile::Symbol& symbol =
+                    input.object.symbols[relocation.symbol];
+                size_t address;
+                if (symbol.defined)
+                    address = input.bases[symbol.section] + symbol.offset;
+                else if (auto found = exports.find(symbol.name);
+                         found != exports.end())
+                    address = found->second.address;
+                else {
+                    errors.push_back(input.name + ": undefined label: " +
+                                     symbol.name + "!");
+                    continue;
+                }
+                if (address > 0xFF) {
+                    errors.push_back(input.name + ": label " + symbol.name +
+                                     " at address " + std::to_string(address) +
+                                     " does not fit into 8 bits!");
+                    continue;
+                }
+                image[input.bases[relocation.section] + relocation.offset] =
+                    address;
+            }
+
+        if (targetSize > 0 && image.size() > targetSize)
+            errors.push_back(
+                "Source code is too big to be compiled to file of size: " +
+                std::to_string(targetSize));
+        if (!errors.empty()) {
+            std::string report;
+            for (const std::string& error : errors)
+                report += (report.empty() ? "" : "\n") + error;
+            throw std::runtime_error(report);
+        }
+        if (targetSize > 0)
+            image.resize(targetSize, 0);
+        return image;
+    }
+};
+
+#endif  // LINKER_HPP
@@ -0,0 +1,323 @@
+#ifndef LOCKSTEP_HPP
+#define LOCKSTEP_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Emulator.hpp"
+
+// The lane loops below are written for the auto-vectorizer. Where the
+// toolchain supports function multiversioning, they are compiled once per
+// vector width and the widest one the host supports is picked at load
+// time. ThreadSanitizer cannot run the ifunc resolvers this needs.
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && \
+    !defined(__SANITIZE_THREAD__)
+#define ASMZ_LANE_CLONES                                          \
+    __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", \
+                                 "default")))
+#else
+#define ASMZ_LANE_CLONES
+#endif
+
+// Runs one program on many CPUs at once, for feeding the same program
+// thousands of input vectors through its IN ports. Instances are stored
+// struct-of-arrays in blocks of 64, one byte lane per instance, so every
+// instruction updates a whole block with a few vector operations. Nothing
+// can store to memory, so the program and its decoded table are shared.
+//
+// All lanes of a block issue one instruction per step: the one at the
+// lowest PC among the lanes still running. Lanes at that PC execute it and
+// the rest are masked off, so lanes split by a JFZ wait for each other and
+// run together again where their paths meet. Every instance ends in the
+// state Emulator::run would leave it in, counters included.
+class LockstepEmulator {
+  public:
+    static constexpr size_t lanes = 64;
+
+  private:
+    using Bytes = std::array<uint8_t, lanes>;
+    using Counters = std::array<uint64_t, lanes>;
+
+    struct alignas(64) Block {
+        Bytes accumulator{};
+        Bytes pc{};
+        Bytes running{};  // 0xFF while the lane has not stopped
+        Bytes reason{};  // StopReason of a stopped lane
+        std::array<Bytes, 8> registers{};
+        std::array<Bytes, 8> inputPorts{};
+        std::array<Bytes, 8> outputPorts{};
+        Counters instructions{};
+        Counters cycles{};
+        Counters remaining{};  // instructions left in this run
+    };
+
+    std::array<uint8_t, 256> memory{};
+    std::array<DecodedInstruction, 256> decoded;
+    std::vector<Block> blocks;
+    size_t count = 0;
+
+    // Selects the new value on the lanes of mask.
+    static uint8_t pick(uint8_t mask, uint8_t value, uint8_t old) {
+        return (value & mask) | (old & ~mask);
+    }
+
+    ASMZ_LANE_CLONES
+    static void runBlock(Block& b,
+                         const std::array<DecodedInstruction, 256>& decoded) {
+        alignas(64) Bytes mask;
+        for (;;) {
+            uint8_t pc = 0xFF;
+            uint8_t any = 0;
+            for (size_t i = 0; i < lanes; i++) {
+                pc = std::min<uint8_t>(pc, b.pc[i] | ~b.running[i]);
+                any |= b.running[i];
+            }
+            if (any == 0)
+                return;
+
+            const DecodedInstruction inst = decoded[pc];
+            uint8_t next = pc + inst.length;
+            for (size_t i = 0; i < lanes; i++) {
+                uint8_t here = b.running[i] & (b.pc[i] == pc ? 0xFF : 0);
+                uint8_t limit = here & (b.remaining[i] == 0 ? 0xFF : 0);
+                b.running[i] &= ~limit;
+                b.reason[i] =
+                    pick(limit, uint8_t(StopReason::STEP_LIMIT), b.reason[i]);
+                mask[i] = here & ~limit;
+            }
+
+            Bytes& acc = b.accumulator;
+            Bytes& rx = b.registers[inst.x];
+            Bytes& ry = b.registers[inst.y];
+            bool jumps = false;
+            switch (inst.op) {
+                case OP_NOP:
+                    break;
+                case OP_LDA:
+                    for (size_t i = 0; i < lanes; i++)
+                        acc[i] = pick(mask[i], inst.immediate, acc[i]);
+                    break;
+                case OP_MV_ACC:
+                    for (size_t i = 0; i < lanes; i++)
+                        rx[i] = pick(mask[i], acc[i], rx[i]);
+                    break;
+                case OP_MV_TO_ACC:
+                    for (size_t i = 0; i < lanes; i++)
+                        acc[i] = pick(mask[i], rx[i], acc[i]);
+                    break;
+                case OP_MV_REG:
+                    for (size_t i = 0; i < lanes; i++)
+                        rx[i] = pick(mask[i], ry[i], rx[i]);
+                    break;
+                case OP_MV_IMM:
+                    for (size_t i = 0; i < lanes; i++)
+                        rx[i] = pick(mask[i], inst.immediate, rx[i]);
+                    break;
+                case OP_ADD_ACC:
+                    for (size_t i = 0; i < lanes; i++)
+                        acc[i] = pick(mask[i], acc[i] + rx[i], acc[i]);
+                    break;
+                case OP_ADD_REG:
+                    for (size_t i = 0; i < lanes; i++)
+                        ry[i] = pick(mask[i], ry[i] + rx[i], ry[i]);
+                    break;
+                case OP_ADD_IMM:
+                    for (size_t i = 0; i < lanes; i++)
+                        rx[i] = pick(mask[i], rx[i] + inst.immediate, rx[i]);
+                    break;
+                case OP_SUB_ACC:
+                    for (size_t i = 0; i < lanes; i++)
+                        acc[i] = pick(mask[i], acc[i] - rx[i], acc[i]);
+                    break;
+                case OP_SUB_REG:
+                    for (size_t i = 0; i < lanes; i++)
+                        ry[i] = pick(mask[i], ry[i] - rx[i], ry[i]);
+                    break;
+                case OP_SUB_IMM:
+                    for (size_t i = 0; i < lanes; i++)
+                        rx[i] = pick(mask[i], rx[i] - inst.immediate, rx[i]);
+                    break;
+                case OP_INC:
+                    for (size_t i = 0; i < lanes; i++)
+                        acc[i] = pick(mask[i], acc[i] + 1, acc[i]);
+                    break;
+                case OP_DEC:
+                    for (size_t i = 0; i < lanes; i++)
+                        acc[i] = pick(mask[i], acc[i] - 1, acc[i]);
+                    break;
+                case OP_JMP_ACC:
+                    for (size_t i = 0; i < lanes; i++)
+                        b.pc[i] = pick(mask[i], acc[i], b.pc[i]);
+                    jumps = true;
+                    break;
+                case OP_JMP_REG:
+                    for (size_t i = 0; i < lanes; i++)
+                        b.pc[i] = pick(mask[i], rx[i], b.pc[i]);
+                    jumps = true;
+                    break;
+                // The divergent branch: each lane's own condition picks
+                // between the target and the fall-through.
+                case OP_JFZ_ACC:
+                    for (size_t i = 0; i < lanes; i++) {
+                        uint8_t taken = acc[i] == 0 ? 0xFF : 0;
+                        b.pc[i] = pick(mask[i], pick(taken, rx[i], next),
+                                       b.pc[i]);
+                    }
+                    jumps = true;
+                    break;
+                case OP_JFZ_REG:
+                    for (size_t i = 0; i < lanes; i++) {
+                        uint8_t taken = ry[i] == 0 ? 0xFF : 0;
+                        b.pc[i] = pick(mask[i], pick(taken, rx[i], next),
+                                       b.pc[i]);
+                    }
+                    jumps = true;
+                    break;
+                case OP_IN: {
+                    Bytes& port = b.inputPorts[inst.y];
+                    for (size_t i = 0; i < lanes; i++)
+                        rx[i] = pick(mask[i], port[i], rx[i]);
+                    break;
+                }
+                case OP_OUT: {
+                    Bytes& port = b.outputPorts[inst.y];
+                    for (size_t i = 0; i < lanes; i++)
+                        port[i] = pick(mask[i], rx[i], port[i]);
+                    break;
+                }
+                // HLT retires and stops; an illegal instruction only
+                // stops. Either way the PC stays on it.
+                case OP_HLT:
+                case OP_ILLEGAL:
+                default: {
+                    StopReason reason = inst.op == OP_HLT
+                                            ? StopReason::HALTED
+                                            : StopReason::ILLEGAL_INSTRUCTION;
+                    for (size_t i = 0; i < lanes; i++) {
+                        b.running[i] &= ~mask[i];
+                        b.reason[i] = pick(mask[i], uint8_t(reason),
+                                           b.reason[i]);
+                    }
+                    jumps = true;
+                    if (inst.op != OP_HLT)
+                        continue;
+                    break;
+                }
+            }
+            if (!jumps)
+                for (size_t i = 0; i < lanes; i++)
+                    b.pc[i] = pick(mask[i], next, b.pc[i]);
+            for (size_t i = 0; i < lanes; i++) {
+                uint64_t issued = mask[i] & 1;
+                b.instructions[i] += issued;
+                b.cycles[i] += issued * inst.length;
+                b.remaining[i] -= issued;
+            }
+        }
+    }
+
+    Block& blockOf(size_t instance) {
+        if (instance >= count)
+            throw std::out_of_range("No such instance: " +
+                                    std::to_string(instance) + "!");
+        return blocks[instance / lanes];
+    }
+    const Block& blockOf(size_t instance) const {
+        return const_cast<LockstepEmulator*>(this)->blockOf(instance);
+    }
+
+  public:
+    LockstepEmulator(std::span<const uint8_t> image, size_t instances)
+        : blocks((instances + lanes - 1) / lanes), count(instances) {
+        if (image.size() > memory.size())
+            throw std::runtime_error(
+                "Image of " + std::to_string(image.size()) +
+                " bytes does not fit into 256 bytes of memory!");
+        std::copy(image.begin(), image.end(), memory.begin());
+        for (size_t pc = 0; pc < decoded.size(); pc++)
+            decoded[pc] = decodeInstruction(memory, pc);
+    }
+
+    size_t size() const { return count; }
+
+    void setInputs(size_t instance, const std::array<uint8_t, 8>& ports) {
+        Block& block = blockOf(instance);
+        for (size_t port = 0; port < ports.size(); port++)
+            block.inputPorts[port][instance % lanes] = ports[port];
+    }
+
+    // Runs every instance until HLT, an undecodable instruction or
+    // maxInstructions executed instructions (0 means no limit), exactly as
+    // Emulator::run does for each of them.
+    void run(uint64_t maxInstructions = 0) {
+        uint64_t budget = maxInstructions == 0 ? UINT64_MAX : maxInstructions;
+        for (size_t first = 0; first < count; first += lanes) {
+            Block& block = blocks[first / lanes];
+            size_t used = std::min(lanes, count - first);
+            for (size_t i = 0; i < lanes; i++) {
+                block.running[i] = i < used ? 0xFF : 0;
+                block.remaining[i] = budget;
+            }
+            runBlock(block, decoded);
+        }
+    }
+
+    StopReason stopReason(size_t instance) const {
+        return StopReason(blockOf(instance).reason[instance % lanes]);
+    }
+
+    // One instance's state, in the form Emulator keeps it.
+    CpuState state(size_t instance) const {
+        const Block& block = blockOf(instance);
+        size_t lane = instance % lanes;
+        CpuState cpu;
+        cpu.accumulator = block.accumulator[lane];
+        cpu.pc = block.pc[lane];
+        cpu.memory = memory;
+        for (size_t r = 0; r < 8; r++) {
+            cpu.registers[r] = block.registers[r][lane];
+            cpu.inputPorts[r] = block.inputPorts[r][lane];
+            cpu.outputPorts[r] = block.outputPorts[r][lane];
+        }
+        cpu.instructions = block.instructions[lane];
+        cpu.cycles = block.cycles[lane];
+        return cpu;
+    }
+
+    // Runs all instances and sums up how they stopped and how fast the
+    // host went, counting every instance's instructions.
+    std::string runAndReport(uint64_t maxInstructions = 0) {
+        auto start = std::chrono::steady_clock::now();
+        run(maxInstructions);
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        std::array<size_t, std::size(stopReasonNames)> stops{};
+        uint64_t instructions = 0;
+        for (size_t i = 0; i < count; i++) {
+            stops[int(stopReason(i))]++;
+            instructions += blocks[i / lanes].instructions[i % lanes];
+        }
+        std::ostringstream out;
+        out << "Instances: " << count;
+        for (size_t i = 0; i < stops.size(); i++)
+            out << (i == 0 ? " (" : ", ") << stopReasonNames[i] << " "
+                << stops[i];
+        out << ")\n";
+        out << "Instructions: " << instructions
+            << ", time: " << elapsed.count() << " s";
+        if (elapsed.count() > 0)
+            out << ", " << instructions / elapsed.count() / 1e6
+                << " M instance-instructions/s";
+        out << "\n";
+        return out.str();
+    }
+};
+
+#endif  // LOCKSTEP_HPP
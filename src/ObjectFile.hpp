@@ -0,0 +1,154 @@
+#ifndef OBJECTFILE_HPP
+#define OBJECTFILE_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A module assembled on its own, for Linker to place and patch later.
+// Every label reference is left as a relocation: the byte at offset in
+// section gets the final address of symbol. Symbols are the module's
+// labels, local unless exported with .global, plus the labels it uses
+// but does not define, which another module has to export.
+//
+// On disk: the magic "AZO1", then the sections (name, bytes), the
+// symbols (name, flags, section, offset) and the relocations (section,
+// offset, symbol). Counts, sizes, indices and offsets are LEB128 varints,
+// names are a varint length followed by the bytes.
+struct ObjectFile {
+    struct Section {
+        std::string name;
+        std::vector<uint8_t> bytes;
+    };
+
+    struct Symbol {
+        std::string name;
+        bool defined = false;
+        bool global = false;
+        uint32_t section = 0;
+        uint32_t offset = 0;
+    };
+
+    struct Relocation {
+        uint32_t section = 0;
+        uint32_t offset = 0;
+        uint32_t symbol = 0;
+    };
+
+    static constexpr std::string_view magic = "AZO1";
+
+    std::vector<Section> sections;
+    std::vector<Symbol> symbols;
+    std::vector<Relocation> relocations;
+
+    std::string serialize() const {
+        std::string out(magic);
+        auto number = [&out](uint64_t value) {
+            do {
+                uint8_t byte = value & 0x7F;
+                value >>= 7;
+                out += char(byte | (value != 0 ? 0x80 : 0));
+            } while (value != 0);
+        };
+        auto text = [&](std::string_view value) {
+            number(value.size());
+            out += value;
+        };
+        number(sections.size());
+        for (const Section& section : sections) {
+            text(section.name);
+            number(section.bytes.size());
+            out.append(section.bytes.begin(), section.bytes.end());
+        }
+        number(symbols.size());
+        for (const Symbol& symbol : symbols) {
+            text(symbol.name);
+            number(uint8_t(symbol.defined) | uint8_t(symbol.global) << 1);
+            number(symbol.section);
+            number(symbol.offset);
+        }
+        number(relocations.size());
+        for (const Relocation& relocation : relocations) {
+            number(relocation.section);
+            number(relocation.offset);
+            number(relocation.symbol);
+        }
+        return out;
+    }
+
+    // Reads what serialize() wrote, checking every index and offset, so
+    // Linker can trust the result. name is only used in errors.
+    static ObjectFile parse(std::string_view data, const std::string& name) {
+        auto fail = [&name](const std::string& problem) {
+            return std::runtime_error(name + ": " + problem + "!");
+        };
+        if (!data.starts_with(magic))
+            throw fail("not an AsmZ object file");
+        size_t at = magic.size();
+        auto number = [&]() -> uint64_t {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                if (at == data.size())
+                    throw fail("object file is truncated");
+                uint8_t byte = data[at++];
+                value |= uint64_t(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    return value;
+            }
+            throw fail("malformed object file");
+        };
+        auto bytes = [&](uint64_t size) {
+            if (size > data.size() - at)
+                throw fail("object file is truncated");
+            std::string_view result = data.substr(at, size);
+            at += size;
+            return result;
+        };
+        // Every entry takes at least a byte, which bounds the allocations.
+        auto count = [&] {
+            uint64_t value = number();
+            if (value > data.size() - at)
+                throw fail("object file is truncated");
+            return value;
+        };
+
+        ObjectFile object;
+        object.sections.resize(count());
+        for (Section& section : object.sections) {
+            section.name = bytes(number());
+            std::string_view content = bytes(number());
+            section.bytes.assign(content.begin(), content.end());
+        }
+        object.symbols.resize(count());
+        for (Symbol& symbol : object.symbols) {
+            symbol.name = bytes(number());
+            uint64_t flags = number();
+            symbol.defined = flags & 1;
+            symbol.global = flags & 2;
+            symbol.section = number();
+            symbol.offset = number();
+            if (symbol.defined &&
+                (symbol.section >= object.sections.size() ||
+                 symbol.offset > object.sections[symbol.section].bytes.size()))
+                throw fail("symbol " + symbol.name + " is out of bounds");
+        }
+        object.relocations.resize(count());
+        for (Relocation& relocation : object.relocations) {
+            relocation.section = number();
+            relocation.offset = number();
+            relocation.symbol = number();
+            if (relocation.section >= object.sections.size() ||
+                relocation.offset >=
+                    object.sections[relocation.section].bytes.size() ||
+                relocation.symbol >= object.symbols.size())
+                throw fail("relocation is out of bounds");
+        }
+        if (at != data.size())
+            throw fail("trailing bytes after the object");
+        return object;
+    }
+};
+
+#endif  // OBJECTFILE_HPP
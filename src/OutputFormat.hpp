@@ -0,0 +1,274 @@
+#ifndef OUTPUTFORMAT_HPP
+#define OUTPUTFORMAT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class OutputFormat {
+    HEX_TEXT,  // one lowercase hex byte per line (the original format)
+    BINARY,
+    INTEL_HEX,
+    LOGISIM
+};
+
+struct ImageEncoder {
+    // The most a bank port can select: 256 banks of 256 bytes.
+    static constexpr size_t maxImageSize = 256 * 256;
+
+    static OutputFormat parseFormat(std::string_view name) {
+        if (name == "hex")
+            return OutputFormat::HEX_TEXT;
+        if (name == "bin")
+            return OutputFormat::BINARY;
+        if (name == "ihex")
+            return OutputFormat::INTEL_HEX;
+        if (name == "logisim")
+            return OutputFormat::LOGISIM;
+        throw std::runtime_error("Unknown output format: " + std::string(name) +
+                                 "! Expected hex, bin, ihex or logisim.");
+    }
+
+    // Renders the whole image into one buffer so it reaches the file in a
+    // single write.
+    static std::string encode(OutputFormat format,
+                              std::span<const uint8_t> image) {
+        std::string result;
+        switch (format) {
+            case OutputFormat::HEX_TEXT:
+                result.reserve(image.size() * 3);
+                for (uint8_t byte : image) {
+                    appendHex(result, byte);
+                    result += '\n';
+                }
+                break;
+            case OutputFormat::BINARY:
+                result.assign(image.begin(), image.end());
+                break;
+            case OutputFormat::INTEL_HEX:
+                encodeIntelHex(result, image);
+                break;
+            case OutputFormat::LOGISIM:
+                encodeLogisim(result, image);
+                break;
+        }
+        return result;
+    }
+
+    // Characters per image byte for formats that give every byte a fixed
+    // place in the file, so a changed range can be rewritten in place.
+    static std::optional<size_t> byteWidth(OutputFormat format) {
+        if (format == OutputFormat::BINARY)
+            return 1;
+        if (format == OutputFormat::HEX_TEXT)
+            return 3;
+        return std::nullopt;
+    }
+
+    // Guesses the encoding of an existing image file from its contents.
+    static OutputFormat detectFormat(std::string_view data) {
+        if (data.starts_with("v2.0 raw"))
+            return OutputFormat::LOGISIM;
+        if (data.starts_with(":"))
+            return OutputFormat::INTEL_HEX;
+        bool text = std::all_of(data.begin(), data.end(), [](char c) {
+            return hexValue(c) >= 0 || c == '\n' || c == '\r';
+        });
+        return text && !data.empty() ? OutputFormat::HEX_TEXT
+                                     : OutputFormat::BINARY;
+    }
+
+    static std::vector<uint8_t> decode(OutputFormat format,
+                                       std::string_view data) {
+        std::vector<uint8_t> image;
+        switch (format) {
+            case OutputFormat::BINARY:
+                image.assign(data.begin(), data.end());
+                break;
+            case OutputFormat::HEX_TEXT:
+                for (std::string_view word : words(data, "\r\n"))
+                    image.push_back(parseByte(word));
+                break;
+            case OutputFormat::INTEL_HEX:
+                decodeIntelHex(image, data);
+                break;
+            case OutputFormat::LOGISIM:
+                decodeLogisim(image, data);
+                break;
+        }
+        return image;
+    }
+
+  private:
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    static uint8_t parseByte(std::string_view text) {
+        if (text.size() != 2 || hexValue(text[0]) < 0 || hexValue(text[1]) < 0)
+            throw std::runtime_error("Malformed image byte: " +
+                                     std::string(text) + "!");
+        return hexValue(text[0]) * 16 + hexValue(text[1]);
+    }
+
+    static std::vector<std::string_view> words(std::string_view data,
+                                               std::string_view separators) {
+        std::vector<std::string_view> result;
+        size_t start = data.find_first_not_of(separators);
+        while (start != data.npos) {
+            size_t end = data.find_first_of(separators, start);
+            result.push_back(data.substr(start, end - start));
+            start = data.find_first_not_of(separators, end);
+        }
+        return result;
+    }
+
+    static std::runtime_error tooLarge() {
+        return std::runtime_error("Image is larger than " +
+                                  std::to_string(maxImageSize) + " bytes!");
+    }
+
+    static void decodeIntelHex(std::vector<uint8_t>& image,
+                               std::string_view data) {
+        size_t base = 0;
+        for (std::string_view line : words(data, "\r\n")) {
+            if (line[0] != ':' || line.size() < 11 || line.size() % 2 == 0)
+                throw std::runtime_error("Malformed Intel HEX record!");
+            std::vector<uint8_t> record;
+            uint8_t checksum = 0;
+            for (size_t i = 1; i < line.size(); i += 2) {
+                record.push_back(parseByte(line.substr(i, 2)));
+                checksum += record.back();
+            }
+            if (checksum != 0 || record[0] + 5u != record.size())
+                throw std::runtime_error("Malformed Intel HEX record!");
+
+            size_t address = record[1] * 256 + record[2];
+            uint8_t type = record[3];
+            if (type == 0x01)
+                break;
+            if (type == 0x04) {
+                if (record[0] != 2)
+                    throw std::runtime_error("Malformed Intel HEX record!");
+                base = (record[4] * 256 + record[5]) << 16;
+            } else if (type == 0x00) {
+                size_t end = base + address + record[0];
+                if (end > maxImageSize)
+                    throw tooLarge();
+                if (image.size() < end)
+                    image.resize(end, 0);
+                std::copy(record.begin() + 4, record.end() - 1,
+                          image.begin() + base + address);
+            }
+        }
+    }
+
+    // A run length, in decimal as Logisim and encodeLogisim write it.
+    static size_t parseCount(std::string_view text) {
+        if (text.empty() || text.size() > 5 ||
+            text.find_first_not_of("0123456789") != text.npos)
+            throw std::runtime_error("Malformed run length: " +
+                                     std::string(text) + "!");
+        size_t count = 0;
+        for (char c : text)
+            count = count * 10 + (c - '0');
+        return count;
+    }
+
+    static void decodeLogisim(std::vector<uint8_t>& image,
+                              std::string_view data) {
+        data.remove_prefix(std::string_view("v2.0 raw").size());
+        for (std::string_view word : words(data, " \t\r\n")) {
+            size_t count = 1;
+            size_t star = word.find('*');
+            if (star != word.npos) {
+                count = parseCount(word.substr(0, star));
+                word.remove_prefix(star + 1);
+            }
+            uint8_t value = word.size() == 1 && hexValue(word[0]) >= 0
+                                ? hexValue(word[0])
+                                : parseByte(word);
+            if (count > maxImageSize - image.size())
+                throw tooLarge();
+            image.insert(image.end(), count, value);
+        }
+    }
+
+    static void appendHex(std::string& out, uint8_t byte, bool upper = false) {
+        const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+        out += digits[byte >> 4];
+        out += digits[byte & 0xF];
+    }
+
+    static void appendRecord(std::string& out,
+                             uint8_t type,
+                             uint16_t address,
+                             std::span<const uint8_t> data) {
+        uint8_t checksum = data.size() + (address >> 8) + (address & 0xFF) +
+                           type;
+        out += ':';
+        appendHex(out, data.size(), true);
+        appendHex(out, address >> 8, true);
+        appendHex(out, address & 0xFF, true);
+        appendHex(out, type, true);
+        for (uint8_t byte : data) {
+            appendHex(out, byte, true);
+            checksum += byte;
+        }
+        appendHex(out, uint8_t(-checksum), true);
+        out += '\n';
+    }
+
+    // Data records of 16 bytes, with extended linear address records
+    // whenever the image crosses a 64 KiB boundary.
+    static void encodeIntelHex(std::string& out,
+                               std::span<const uint8_t> image) {
+        constexpr size_t recordSize = 16;
+        out.reserve(image.size() / recordSize * 44 + 12);
+        for (size_t offset = 0; offset < image.size(); offset += recordSize) {
+            if (offset > 0 && (offset & 0xFFFF) == 0) {
+                const uint8_t upper[] = {uint8_t(offset >> 24),
+                                         uint8_t(offset >> 16)};
+                appendRecord(out, 0x04, 0, upper);
+            }
+            appendRecord(out, 0x00, offset & 0xFFFF,
+                         image.subspan(offset, std::min(recordSize,
+                                                        image.size() - offset)));
+        }
+        appendRecord(out, 0x01, 0, {});
+    }
+
+    // Logisim "v2.0 raw" ROM image, 16 values per line. Runs of four or
+    // more equal bytes (typically --binary-size padding) use count*value.
+    static void encodeLogisim(std::string& out,
+                              std::span<const uint8_t> image) {
+        out = "v2.0 raw\n";
+        size_t column = 0;
+        for (size_t i = 0; i < image.size();) {
+            size_t run = 1;
+            while (i + run < image.size() && image[i + run] == image[i])
+                run++;
+            if (run >= 4) {
+                out += std::to_string(run);
+                out += '*';
+            } else
+                run = 1;
+            appendHex(out, image[i]);
+            i += run;
+            out += (++column % 16 == 0 || i == image.size()) ? '\n' : ' ';
+        }
+    }
+};
+
+#endif  // OUTPUTFORMAT_HPP
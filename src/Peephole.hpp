@@ -0,0 +1,230 @@
+#ifndef PEEPHOLE_HPP
+#define PEEPHOLE_HPP
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include "Commands.hpp"
+#include "IR.hpp"
+
+// Pattern-matching rewrites over a short window of parsed statements,
+// applied to the whole Program between parsing and layout. The window is
+// cleared at every label, since a jump may land between two statements,
+// and at every statement that uses a label. Rules only look at
+// register/accumulator state: the CPU has no flags, so dropping an
+// instruction that leaves every register as it was is always safe, as
+// long as every jump lands on a label. Hand-written hex addresses are not
+// relocated, so a program where a literal, a port or arithmetic can reach
+// the target of a JMP or JFZ is left as it is.
+class PeepholeOptimizer {
+  public:
+    enum Rule {
+        REDUNDANT_RELOAD,  // MV Rx, A; MV Rx  or  MV Rx; MV Rx, A
+        CANCELLING_INC_DEC,  // INC; DEC  or  DEC; INC
+        ZERO_ADD_SUB,  // ADD Rx, 00  or  SUB Rx, 00
+        SELF_MOVE,  // MV Rx, Rx
+        RULE_COUNT
+    };
+
+    static constexpr std::array<const char*, RULE_COUNT> ruleNames = {
+        "redundant-reload", "cancelling-inc-dec", "zero-add-sub",
+        "self-move"};
+
+    struct RuleStats {
+        size_t applied = 0;
+        size_t bytesSaved = 0;
+    };
+
+  private:
+    static constexpr size_t window = 2;
+    std::array<size_t, window + 1> pending;  // statement indices, oldest first
+    size_t pendingCount = 0;
+    std::array<RuleStats, RULE_COUNT> stats{};
+    std::string skipped;  // names the line that stopped the last run
+
+    // Bits 0-7 are the registers.
+    static constexpr uint16_t accumulatorBit = 1 << 8;
+
+    static bool isRegister(const Program& program,
+                           size_t statement,
+                           size_t operand,
+                           uint8_t value) {
+        return program.kind(statement, operand) == REGISTER &&
+               program.value(statement, operand) == value;
+    }
+
+    void drop(Program& program, Rule rule, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            size_t statement = pending[--pendingCount];
+            stats[rule].bytesSaved += program.encoding(statement).size;
+            program.remove(statement);
+        }
+        stats[rule].applied++;
+    }
+
+    // Tries every rule against the newest statements; true if one fired.
+    bool rewriteTail(Program& program) {
+        size_t last = pending[pendingCount - 1];
+        const CommandDescriptor* command = program.command(last);
+        if ((command == &cADD || command == &cSUB) &&
+            program.kind(last, 0) == REGISTER &&
+            program.kind(last, 1) == LITERAL && program.value(last, 1) == 0) {
+            drop(program, ZERO_ADD_SUB, 1);
+            return true;
+        }
+        if (command == &cMV2 && program.kind(last, 0) == REGISTER &&
+            isRegister(program, last, 1, program.value(last, 0))) {
+            drop(program, SELF_MOVE, 1);
+            return true;
+        }
+        if (pendingCount < 2)
+            return false;
+
+        size_t previous = pending[pendingCount - 2];
+        const CommandDescriptor* before = program.command(previous);
+        if ((before == &cINC && command == &cDEC) ||
+            (before == &cDEC && command == &cINC)) {
+            drop(program, CANCELLING_INC_DEC, 2);
+            return true;
+        }
+        // After MV Rx, A or MV Rx the accumulator and Rx hold the same
+        // value, so copying either way again changes nothing.
+        auto syncs = [&](size_t statement, uint8_t& reg) {
+            const CommandDescriptor* desc = program.command(statement);
+            if (desc == &cMV1 ||
+                (desc == &cMV2 && program.kind(statement, 1) == ACCUMULATOR)) {
+                reg = program.value(statement, 0);
+                return true;
+            }
+            return false;
+        };
+        uint8_t first, second;
+        if (syncs(previous, first) && syncs(last, second) && first == second) {
+            drop(program, REDUNDANT_RELOAD, 1);
+            return true;
+        }
+        return false;
+    }
+
+    // The registers and accumulator statement i copies into the location
+    // written, as a mask, or 0 when it writes none of targets.
+    static uint16_t copiedInto(const Program& program,
+                               size_t i,
+                               uint16_t targets) {
+        const CommandDescriptor* command = program.command(i);
+        auto location = [&](size_t operand) -> uint16_t {
+            if (program.kind(i, operand) == ACCUMULATOR)
+                return accumulatorBit;
+            if (program.kind(i, operand) == REGISTER)
+                return 1 << program.value(i, operand);
+            return 0;
+        };
+        if (command == &cMV1)  // Acc = Rx
+            return targets & accumulatorBit ? location(0) : 0;
+        if (command == &cMV2 || command == &cADD || command == &cSUB)
+            return targets & location(0) ? location(1) : 0;
+        return 0;
+    }
+
+    // Whether statement i puts something other than a label's address or
+    // a copy into one of targets: a literal, a port value or a sum.
+    static bool writesNonLabel(const Program& program,
+                               size_t i,
+                               uint16_t targets) {
+        const CommandDescriptor* command = program.command(i);
+        if (command == &cLDA || command == &cINC || command == &cDEC)
+            return targets & accumulatorBit;
+        if (command == &cIN)
+            return targets & (1 << program.value(i, 0));
+        if (command == &cMV2)
+            return program.kind(i, 1) == LITERAL && !program.symbolic(i) &&
+                   targets & (1 << program.value(i, 0));
+        if (command == &cADD || command == &cSUB)
+            return targets & (program.kind(i, 0) == ACCUMULATOR
+                                  ? accumulatorBit
+                                  : 1 << program.value(i, 0));
+        return false;
+    }
+
+    // The line of a statement that can put a value other than a label's
+    // address into a jump target, or 0. Ignores control flow: a register
+    // is a jump target everywhere if it is one anywhere.
+    static uint32_t unrelocatableTarget(const Program& program) {
+        uint16_t targets = 0;
+        for (size_t i = 0; i < program.size(); i++) {
+            const CommandDescriptor* command = program.command(i);
+            if (command != &cJMP && command != &cJFZ)
+                continue;
+            size_t target = command->opcount - 1;
+            targets |= program.kind(i, target) == ACCUMULATOR
+                           ? accumulatorBit
+                           : 1 << program.value(i, target);
+        }
+        for (uint16_t grown = targets; grown != 0;) {
+            grown = 0;
+            for (size_t i = 0; i < program.size(); i++)
+                grown |= copiedInto(program, i, targets) & ~targets;
+            targets |= grown;
+        }
+        for (size_t i = 0; i < program.size(); i++)
+            if (targets != 0 && writesNonLabel(program, i, targets))
+                return program.line(i);
+        return 0;
+    }
+
+  public:
+    // Removes the statements the rules make redundant, in one pass. Does
+    // nothing if unrelocatableTarget finds a jump it cannot keep; the
+    // report then names its line with describeLine.
+    template <typename DescribeLine>
+    void run(Program& program, DescribeLine describeLine) {
+        skipped.clear();
+        if (uint32_t line = unrelocatableTarget(program)) {
+            skipped = describeLine(line);
+            return;
+        }
+        pendingCount = 0;
+        size_t label = 0;
+        for (size_t i = 0; i < program.size(); i++) {
+            for (; label < program.labelCount() &&
+                   program.labelStatement(label) <= i;
+                 label++)
+                pendingCount = 0;
+            if (!program.live(i))
+                continue;
+            if (program.symbolic(i)) {
+                pendingCount = 0;
+                continue;
+            }
+            pending[pendingCount++] = i;
+            while (pendingCount > 0 && rewriteTail(program)) {
+            }
+            if (pendingCount > window) {
+                std::copy(pending.begin() + 1, pending.end(), pending.begin());
+                pendingCount--;
+            }
+        }
+    }
+
+    const std::array<RuleStats, RULE_COUNT>& getStats() const { return stats; }
+    std::string report() const {
+        if (!skipped.empty())
+            return "Optimizer skipped: " + skipped +
+                   " can put an address that is not a label into a jump "
+                   "target.\n";
+        std::string result;
+        size_t total = 0;
+        for (size_t rule = 0; rule < RULE_COUNT; rule++) {
+            if (stats[rule].applied == 0)
+                continue;
+            result += std::string(ruleNames[rule]) + ": " +
+                      std::to_string(stats[rule].applied) + " applied, " +
+                      std::to_string(stats[rule].bytesSaved) + " bytes saved\n";
+            total += stats[rule].bytesSaved;
+        }
+        return result + "Optimizer saved " + std::to_string(total) +
+               " bytes.\n";
+    }
+};
+
+#endif  // PEEPHOLE_HPP
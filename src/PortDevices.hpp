@@ -0,0 +1,169 @@
+#ifndef PORTDEVICES_HPP
+#define PORTDEVICES_HPP
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <thread>
+#include <vector>
+#include "Emulator.hpp"
+#include "PortRing.hpp"
+
+// Host ends of an Emulator's streamed ports. Each device gets a PortRing
+// attached to its port and a thread that moves data between the ring and
+// a stream or callback a chunk at a time, so the running program only
+// touches rings: no locks and no calls into a device per byte.
+class PortDevices {
+  public:
+    // Fills the chunk it is given and returns how many bytes it wrote; 0
+    // ends the input.
+    using Source = std::function<size_t(std::span<uint8_t>)>;
+    using Sink = std::function<void(std::span<const uint8_t>)>;
+
+  private:
+    static constexpr size_t chunkSize = 4096;
+
+    struct Device {
+        std::unique_ptr<PortRing> ring;
+        std::thread thread;
+    };
+
+    Emulator& emulator;
+    size_t ringCapacity;
+    std::array<Device, 8> inputs;
+    std::array<Device, 8> outputs;
+    std::atomic<bool> stopping{false};
+
+    static void produce(PortRing& ring,
+                        const Source& source,
+                        const std::atomic<bool>& stopping) {
+        std::vector<uint8_t> chunk(chunkSize);
+        while (size_t size = source(chunk)) {
+            std::span<const uint8_t> rest(chunk.data(), size);
+            while (!rest.empty()) {
+                rest = rest.subspan(ring.write(rest));
+                if (stopping.load(std::memory_order_relaxed))
+                    return;
+                if (!rest.empty())
+                    std::this_thread::yield();
+            }
+        }
+        ring.close();
+    }
+
+    static void consume(PortRing& ring, const Sink& sink) {
+        std::vector<uint8_t> chunk(chunkSize);
+        for (;;) {
+            if (size_t size = ring.read(chunk))
+                sink(std::span<const uint8_t>(chunk.data(), size));
+            else if (ring.finished())
+                return;
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    Device& bind(std::array<Device, 8>& devices, uint8_t port) {
+        Device& device = devices.at(port);
+        if (device.ring != nullptr)
+            throw std::runtime_error("Port " + std::to_string(port) +
+                                     " already has a device!");
+        device.ring = std::make_unique<PortRing>(ringCapacity);
+        return device;
+    }
+
+  public:
+    explicit PortDevices(Emulator& emulator, size_t ringCapacity = 1 << 16)
+        : emulator(emulator), ringCapacity(ringCapacity) {}
+
+    PortDevices(const PortDevices&) = delete;
+    PortDevices& operator=(const PortDevices&) = delete;
+
+    ~PortDevices() { finish(); }
+
+    void input(uint8_t port, Source source) {
+        Device& device = bind(inputs, port);
+        device.thread = std::thread(produce, std::ref(*device.ring),
+                                    std::move(source), std::cref(stopping));
+        emulator.attachInput(port, device.ring.get());
+    }
+
+    // Reads whole chunks, so a pipe feeds the program in batches.
+    void input(uint8_t port, std::istream& stream) {
+        input(port, [&stream](std::span<uint8_t> chunk) -> size_t {
+            stream.read(reinterpret_cast<char*>(chunk.data()), chunk.size());
+            return stream.gcount();
+        });
+    }
+
+    void output(uint8_t port, Sink sink) {
+        Device& device = bind(outputs, port);
+        device.thread = std::thread(consume, std::ref(*device.ring),
+                                    std::move(sink));
+        emulator.attachOutput(port, device.ring.get());
+    }
+
+    void output(uint8_t port, std::ostream& stream) {
+        output(port, [&stream](std::span<const uint8_t> chunk) {
+            stream.write(reinterpret_cast<const char*>(chunk.data()),
+                         chunk.size());
+        });
+    }
+
+    // Runs the emulator until it halts, faults or executes maxInstructions
+    // (0 means no limit), waiting for the devices whenever a port blocks
+    // it. Stops with PORT_BLOCKED only when an input has ended.
+    StopReason run(uint64_t maxInstructions = 0) {
+        const CpuState& cpu = emulator.state();
+        uint64_t end = cpu.instructions + maxInstructions;
+        for (;;) {
+            uint64_t remaining = 0;
+            if (maxInstructions != 0) {
+                if (cpu.instructions == end)
+                    return StopReason::STEP_LIMIT;
+                remaining = end - cpu.instructions;
+            }
+            StopReason reason = emulator.run(remaining);
+            if (reason != StopReason::PORT_BLOCKED)
+                return reason;
+            const DecodedInstruction& inst = emulator.decodedAt(cpu.pc);
+            bool in = inst.op == OP_IN;
+            PortRing* ring = (in ? inputs : outputs)[inst.y].ring.get();
+            if (ring == nullptr)  // attached by someone else
+                return reason;
+            while (in ? ring->empty() : ring->full()) {
+                if (in && ring->finished())
+                    return reason;
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Detaches every device, passing on all output written so far. Input
+    // not read yet is dropped, though a source blocked in a read is waited
+    // for.
+    void finish() {
+        stopping = true;
+        for (size_t port = 0; port < 8; port++) {
+            if (inputs[port].ring != nullptr)
+                emulator.attachInput(port, nullptr);
+            if (outputs[port].ring != nullptr) {
+                emulator.attachOutput(port, nullptr);
+                outputs[port].ring->close();
+            }
+        }
+        for (std::array<Device, 8>* devices : {&inputs, &outputs})
+            for (Device& device : *devices) {
+                if (device.thread.joinable())
+                    device.thread.join();
+                device.ring.reset();
+            }
+        stopping = false;
+    }
+};
+
+#endif  // PORTDEVICES_HPP
@@ -0,0 +1,116 @@
+#ifndef PORTRING_HPP
+#define PORTRING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+
+// Lock-free byte queue between exactly one producer thread and one consumer
+// thread, the emulator being one of the two. The capacity is a power of
+// two and the indices run freely, masked on access. Each side keeps a copy
+// of the other side's index and reloads it only when the ring looks full or
+// empty, so the shared cache lines move once per batch, not once per byte.
+class PortRing {
+    std::unique_ptr<uint8_t[]> buffer;
+    size_t mask;
+
+    alignas(64) std::atomic<size_t> head{0};  // next read; the consumer's
+    size_t knownTail = 0;
+    alignas(64) std::atomic<size_t> tail{0};  // next write; the producer's
+    size_t knownHead = 0;
+    alignas(64) std::atomic<bool> closed{false};
+
+    static size_t roundUp(size_t capacity) {
+        size_t result = 1;
+        while (result < capacity)
+            result <<= 1;
+        return result;
+    }
+
+  public:
+    explicit PortRing(size_t capacity = 4096)
+        : buffer(new uint8_t[roundUp(capacity)]),
+          mask(roundUp(capacity) - 1) {}
+
+    PortRing(const PortRing&) = delete;
+    PortRing& operator=(const PortRing&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    // Producer side.
+
+    bool full() {
+        size_t at = tail.load(std::memory_order_relaxed);
+        if (at - knownHead <= mask)
+            return false;
+        knownHead = head.load(std::memory_order_acquire);
+        return at - knownHead > mask;
+    }
+
+    bool push(uint8_t value) {
+        if (full())
+            return false;
+        size_t at = tail.load(std::memory_order_relaxed);
+        buffer[at & mask] = value;
+        tail.store(at + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Appends as much of data as fits; returns how much that was.
+    size_t write(std::span<const uint8_t> data) {
+        size_t at = tail.load(std::memory_order_relaxed);
+        if (at - knownHead + data.size() > capacity())
+            knownHead = head.load(std::memory_order_acquire);
+        size_t count = std::min(data.size(), capacity() - (at - knownHead));
+        size_t first = std::min(count, capacity() - (at & mask));
+        std::memcpy(&buffer[at & mask], data.data(), first);
+        std::memcpy(&buffer[0], data.data() + first, count - first);
+        tail.store(at + count, std::memory_order_release);
+        return count;
+    }
+
+    // No more bytes will be written.
+    void close() { closed.store(true, std::memory_order_release); }
+
+    // Consumer side.
+
+    bool empty() {
+        size_t at = head.load(std::memory_order_relaxed);
+        if (at != knownTail)
+            return false;
+        knownTail = tail.load(std::memory_order_acquire);
+        return at == knownTail;
+    }
+
+    bool pop(uint8_t& value) {
+        if (empty())
+            return false;
+        size_t at = head.load(std::memory_order_relaxed);
+        value = buffer[at & mask];
+        head.store(at + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Takes up to out.size() bytes; returns how many it took.
+    size_t read(std::span<uint8_t> out) {
+        size_t at = head.load(std::memory_order_relaxed);
+        if (knownTail - at < out.size())
+            knownTail = tail.load(std::memory_order_acquire);
+        size_t count = std::min(out.size(), knownTail - at);
+        size_t first = std::min(count, capacity() - (at & mask));
+        std::memcpy(out.data(), &buffer[at & mask], first);
+        std::memcpy(out.data() + first, &buffer[0], count - first);
+        head.store(at + count, std::memory_order_release);
+        return count;
+    }
+
+    // Closed and every byte taken: nothing more will come.
+    bool finished() {
+        return closed.load(std::memory_order_acquire) && empty();
+    }
+};
+
+#endif  // PORTRING_HPP
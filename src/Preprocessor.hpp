@@ -0,0 +1,884 @@
+#ifndef PREPROCESSOR_HPP
+#define PREPROCESSOR_HPP
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Commands.hpp"
+#include "Diagnostics.hpp"
+#include "Lexer.hpp"
+#include "SourceFile.hpp"
+#include "Types.hpp"
+
+// A problem found while reading a macro or include file, kept until it can
+// be reported against the lines it is about.
+struct PreprocessorError {
+    size_t line = 0;  // relative to the first line of the text it is about
+    size_t column = 0;
+    std::string token;
+    std::string message;
+};
+
+// Recognizes the preprocessor's directives: the first word of a line, or
+// the second when the first is a label.
+struct Directives {
+    enum Kind { NONE, INCLUDE, MACRO, ENDM, REPT, ENDR };
+
+    // Unlike TokenList, keeps every word: macros take any number of them.
+    using Words = std::vector<Token>;
+
+    static void split(std::string_view line, Words& words) {
+        words.clear();
+        size_t comment = line.find("//");
+        if (comment != line.npos)
+            line = line.substr(0, comment);
+        for (size_t i = 0; i < line.size();) {
+            while (i < line.size() && Lexer::isDelimiter(line[i]))
+                i++;
+            size_t start = i;
+            while (i < line.size() && !Lexer::isDelimiter(line[i]))
+                i++;
+            if (start != i)
+                words.push_back({line.substr(start, i - start), {0, start + 1}});
+        }
+    }
+
+    // Index of the word that says what the line is: 1 after a label.
+    static size_t head(const Words& words) {
+        return !words.empty() && words[0].text.ends_with(':') ? 1 : 0;
+    }
+
+    static Kind kindOf(std::string_view word) {
+        if (word.empty() || word[0] != '.')
+            return NONE;
+        if (word == ".include")
+            return INCLUDE;
+        if (word == ".macro")
+            return MACRO;
+        if (word == ".endm")
+            return ENDM;
+        if (word == ".rept")
+            return REPT;
+        if (word == ".endr")
+            return ENDR;
+        return NONE;
+    }
+
+    static Kind classify(std::string_view line, Words& words) {
+        split(line, words);
+        size_t at = head(words);
+        return at < words.size() ? kindOf(words[at].text) : NONE;
+    }
+
+    // The file an .include line names: the rest of the line, so it may
+    // contain spaces, without the quotes around it.
+    static std::string_view includeName(std::string_view line,
+                                        const Words& words,
+                                        size_t at) {
+        if (words.size() == at + 1)
+            return {};
+        std::string_view name = line.substr(words[at + 1].position.column - 1);
+        name = name.substr(0, name.find("//"));
+        while (!name.empty() && Lexer::isDelimiter(name.back()))
+            name.remove_suffix(1);
+        if (name.size() >= 2 && name.front() == '"' && name.back() == '"')
+            name = name.substr(1, name.size() - 2);
+        return name;
+    }
+
+    // Index of the directive that closes the block opened at lines[open],
+    // or lines.size() if there is none. .rept blocks nest.
+    static size_t findEnd(std::span<const std::string_view> lines,
+                          size_t open,
+                          Kind kind) {
+        Words words;
+        size_t nesting = 0;
+        for (size_t i = open + 1; i < lines.size(); i++) {
+            Kind found = classify(lines[i], words);
+            if (kind == MACRO && found == ENDM)
+                return i;
+            if (kind == REPT && found == REPT)
+                nesting++;
+            else if (kind == REPT && found == ENDR && nesting-- == 0)
+                return i;
+        }
+        return lines.size();
+    }
+};
+
+// A macro body split at every parameter reference, so an expansion only
+// concatenates pieces. In the body, \name stands for the argument given for
+// parameter name, \@ for a number unique to each expansion (for labels
+// local to it), and \() for nothing, to end a name written right before
+// other identifier characters.
+struct Macro {
+    static constexpr int32_t TEXT = -1;
+    static constexpr int32_t COUNTER = -2;
+
+    struct Piece {
+        uint32_t offset = 0;  // into body, for TEXT
+        uint32_t length = 0;
+        int32_t parameter = TEXT;  // index of the parameter, TEXT or COUNTER
+    };
+
+    std::string name;
+    std::vector<std::string> parameters;
+    std::string body;
+    std::vector<Piece> pieces;
+    std::vector<uint32_t> lineEnds;  // one past each body line's pieces
+    const std::string* file = nullptr;  // where the macro is defined
+    size_t line = 0;  // of the .macro directive
+
+    static bool isParameterChar(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+               (c >= '0' && c <= '9') || c == '_';
+    }
+
+    // Parses ".macro NAME a, b" (header, with .macro at word at) and the
+    // body lines between it and .endm. On error fills error, its line
+    // counted from the header, and returns nullptr.
+    static std::shared_ptr<const Macro> define(
+        const Directives::Words& header,
+        size_t at,
+        std::span<const std::string_view> lines,
+        const std::string* file,
+        size_t line,
+        PreprocessorError& error) {
+        auto fail = [&error](size_t line, const Token& token,
+                             std::string message) {
+            error = {line, token.position.column, std::string(token.text),
+                     std::move(message)};
+            return nullptr;
+        };
+
+        if (header.size() == at + 1)
+            return fail(0, header[at], "Expected a macro name after .macro!");
+        auto macro = std::make_shared<Macro>();
+        macro->file = file;
+        macro->line = line;
+        const Token& name = header[at + 1];
+        macro->name = name.text;
+        if (!Operand::isSymbolName(name.text) || name.text[0] == '.')
+            return fail(0, name, "Invalid macro name: " + macro->name +
+                                     "! Macro names follow the rules for "
+                                     "labels and do not start with a dot.");
+        for (const CommandDescriptor* command : builtinCommands)
+            if (name.text == command->name)
+                return fail(0, name, "Macro " + macro->name +
+                                         " would hide the instruction " +
+                                         macro->name + "!");
+        for (size_t i = at + 2; i < header.size(); i++) {
+            std::string_view parameter = header[i].text;
+            bool valid = true;
+            for (char c : parameter)
+                valid = valid && isParameterChar(c);
+            if (!valid)
+                return fail(0, header[i], "Invalid macro parameter name: " +
+                                              std::string(parameter) + "!");
+            for (const std::string& other : macro->parameters)
+                if (other == parameter)
+                    return fail(0, header[i],
+                                "Macro parameter " + other +
+                                    " is listed twice!");
+            macro->parameters.emplace_back(parameter);
+        }
+
+        Directives::Words words;
+        for (size_t k = 0; k < lines.size(); k++) {
+            std::string_view text = lines[k];
+            if (Directives::classify(text, words) == Directives::MACRO)
+                return fail(k + 1, words[Directives::head(words)],
+                            "Macros cannot be defined inside .macro!");
+            // References in comments are left alone.
+            size_t end = std::min(text.find("//"), text.size());
+            size_t start = 0;
+            for (size_t i = text.find('\\'); i < end;
+                 i = text.find('\\', start)) {
+                macro->addText(text.substr(start, i - start));
+                size_t nameEnd = i + 1;
+                if (text.substr(i + 1, 1) == "@") {
+                    macro->pieces.push_back({0, 0, COUNTER});
+                    nameEnd = i + 2;
+                } else if (text.substr(i + 1, 2) == "()") {
+                    nameEnd = i + 3;
+                } else {
+                    while (nameEnd < end && isParameterChar(text[nameEnd]))
+                        nameEnd++;
+                    std::string_view reference =
+                        text.substr(i + 1, nameEnd - i - 1);
+                    size_t index = 0;
+                    while (index < macro->parameters.size() &&
+                           macro->parameters[index] != reference)
+                        index++;
+                    if (index == macro->parameters.size())
+                        return fail(k + 1,
+                                    {text.substr(i, nameEnd - i), {0, i + 1}},
+                                    "Unknown macro parameter: \\" +
+                                        std::string(reference) + "!");
+                    macro->pieces.push_back({0, 0, int32_t(index)});
+                }
+                start = nameEnd;
+            }
+            macro->addText(text.substr(start));
+            macro->lineEnds.push_back(macro->pieces.size());
+        }
+        return macro;
+    }
+
+  private:
+    void addText(std::string_view text) {
+        if (text.empty())
+            return;
+        pieces.push_back({uint32_t(body.size()), uint32_t(text.size()), TEXT});
+        body += text;
+    }
+};
+
+// One source file read for .include, with the macros it defines already
+// parsed. Immutable once read, so translations on any thread share it.
+struct IncludedFile {
+    struct Definition {
+        std::shared_ptr<const Macro> macro;  // nullptr if error is set
+        size_t end = 0;  // index of the closing .endm line
+        std::optional<PreprocessorError> error;
+    };
+
+    std::string path;  // as shown in diagnostics
+    std::filesystem::path canonical;
+    std::string text;
+    std::vector<std::string_view> lines;
+    std::unordered_map<size_t, Definition> definitions;  // by .macro line
+
+    static std::shared_ptr<const IncludedFile> read(
+        const std::filesystem::path& canonical) {
+        auto file = std::make_shared<IncludedFile>();
+        file->canonical = canonical;
+        file->path = std::filesystem::proximate(canonical).string();
+        file->text = SourceFile(canonical.string()).text();
+        forEachLine(file->text, [&file](std::string_view line, size_t) {
+            file->lines.push_back(line);
+        });
+
+        Directives::Words words;
+        for (size_t i = 0; i < file->lines.size(); i++) {
+            if (Directives::classify(file->lines[i], words) !=
+                Directives::MACRO)
+                continue;
+            Definition& definition = file->definitions[i];
+            definition.end =
+                Directives::findEnd(file->lines, i, Directives::MACRO);
+            // A missing .endm is reported when the file is processed.
+            if (definition.end == file->lines.size())
+                continue;
+            PreprocessorError error;
+            definition.macro = Macro::define(
+                words, Directives::head(words),
+                std::span(file->lines).subspan(i + 1, definition.end - i - 1),
+                &file->path, i + 1, error);
+            if (definition.macro == nullptr)
+                definition.error = std::move(error);
+        }
+        return file;
+    }
+};
+
+// Included files by canonical path, shared by every translation in the
+// process: a header included by a thousand sources of one batch is read and
+// its macros parsed once. An entry is reused while the file keeps its
+// modification time and size.
+class IncludeCache {
+    struct Entry {
+        std::filesystem::file_time_type time;
+        uintmax_t size = 0;
+        std::shared_ptr<const IncludedFile> file;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    size_t reads = 0;
+
+  public:
+    static IncludeCache& shared() {
+        static IncludeCache cache;
+        return cache;
+    }
+
+    std::shared_ptr<const IncludedFile> load(const std::filesystem::path& path) {
+        std::error_code error;
+        std::filesystem::path canonical =
+            std::filesystem::canonical(path, error);
+        if (error || !std::filesystem::is_regular_file(canonical))
+            throw std::runtime_error("Cannot open " +
+                                     path.lexically_normal().string() + "!");
+        Entry entry{std::filesystem::last_write_time(canonical, error),
+                    std::filesystem::file_size(canonical, error), nullptr};
+        {
+            std::lock_guard lock(mutex);
+            auto found = entries.find(canonical.string());
+            if (found != entries.end() && found->second.time == entry.time &&
+                found->second.size == entry.size)
+                return found->second.file;
+        }
+        // Read unlocked: two threads may both read a file that is new to
+        // the cache, but reading one file never waits for another.
+        entry.file = IncludedFile::read(canonical);
+        std::lock_guard lock(mutex);
+        reads++;
+        entries[canonical.string()] = entry;
+        return entry.file;
+    }
+
+    size_t getReads() {
+        std::lock_guard lock(mutex);
+        return reads;
+    }
+};
+
+// Expands .include, .macro/.endm and .rept/.endr between the source and an
+// Assembler. Lines are pushed in one at a time with feed() and come out
+// one at a time through the sink, so neither the source nor its expansion
+// is ever held as a whole; only the body of a .macro or .rept in the main
+// source is buffered until its closing directive.
+//
+//     .include "io.z"         // relative to the including file
+//     .macro LOAD reg, value  // \reg and \value in the body
+//     loop\@: LDA \value      // \@: unique per expansion
+//     .endm
+//     .rept 4                 // hex count, like every number
+//     NOP
+//     .endr
+//
+// Lines reach the sink numbered in the order they are fed; getLineMap()
+// translates those numbers back into files and lines. Problems go into
+// diagnostics next to the assembler's own, so one run still reports all of
+// them. Other lines, including unknown dot-words, pass through unchanged.
+class Preprocessor {
+  public:
+    using Sink = std::function<void(std::string_view line, size_t lineNumber)>;
+
+    static constexpr size_t maxDepth = 64;
+    // Lines one outermost .rept may expand to, nested blocks included.
+    static constexpr size_t maxRepeatedLines = 1 << 20;
+
+  private:
+    using Words = Directives::Words;
+    using Origin = LineMap::Location;
+
+    enum class State { NORMAL, MACRO, REPT };
+
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    std::string sourceName;
+    std::filesystem::path directory;
+    std::filesystem::path canonical;  // empty for standard input
+    Diagnostics& diagnostics;
+    Sink sink;
+    IncludeCache& cache;
+    LineMap lineMap;
+    std::unordered_map<std::string,
+                       std::shared_ptr<const Macro>,
+                       NameHash,
+                       std::equal_to<>>
+        macros;
+    std::vector<std::shared_ptr<const IncludedFile>> included;
+    std::vector<const IncludedFile*> includeStack;
+    size_t fed = 0;
+    size_t expansions = 0;
+    size_t depth = 0;
+    std::optional<size_t> repeatStart;  // fed when the outermost .rept began
+    bool repeatStopped = false;
+    Words words;
+
+    // A .macro or .rept block of the main source, until it is closed.
+    State state = State::NORMAL;
+    std::string header;
+    size_t headerLine = 0;
+    size_t nesting = 0;
+    std::string block;
+    std::vector<uint32_t> blockStarts;
+
+    void emit(std::string_view line, Origin origin) {
+        lineMap.add(++fed, origin);
+        sink(line, fed);
+    }
+
+    // Reported under a line number of its own that is never fed.
+    void error(Origin origin,
+               size_t column,
+               std::string_view token,
+               std::string message,
+               std::string_view line) {
+        lineMap.add(++fed, origin);
+        if (line.ends_with('\r'))
+            line.remove_suffix(1);
+        diagnostics.add({fed, column}, token, std::move(message), line);
+    }
+
+    void error(Origin origin,
+               const Token& token,
+               std::string message,
+               std::string_view line) {
+        error(origin, token.position.column, token.text, std::move(message),
+              line);
+    }
+
+    // Most lines: no directive, and no word that could name a macro. Every
+    // directive has a dot, so without macros one memchr decides.
+    bool plain(std::string_view line) const {
+        if (macros.empty())
+            return std::memchr(line.data(), '.', line.size()) == nullptr;
+        size_t end = std::min(line.find("//"), line.size());
+        size_t i = 0;
+        while (i < end && Lexer::isDelimiter(line[i]))
+            i++;
+        return i == end;
+    }
+
+    const Macro* findMacro(const Words& words, size_t at) const {
+        if (at >= words.size() || macros.empty())
+            return nullptr;
+        auto found = macros.find(words[at].text);
+        return found == macros.end() ? nullptr : found->second.get();
+    }
+
+    void define(std::shared_ptr<const Macro> macro,
+                Origin origin,
+                const Words& words,
+                std::string_view line) {
+        auto [found, added] = macros.try_emplace(macro->name, macro);
+        if (!added)
+            error(origin, words[Directives::head(words) + 1],
+                  "Macro " + macro->name + " is already defined at " +
+                      *found->second->file + ":" +
+                      std::to_string(found->second->line) + "!",
+                  line);
+    }
+
+    void reportDefinition(const PreprocessorError& problem,
+                          Origin origin,
+                          std::string_view line) {
+        origin.line += problem.line;
+        error(origin, problem.column, problem.token, problem.message, line);
+    }
+
+    std::optional<size_t> repeatCount(const Words& words,
+                                      size_t at,
+                                      Origin origin,
+                                      std::string_view line) {
+        if (words.size() != at + 2) {
+            error(origin, words[at], "Expected one repeat count after .rept!",
+                  line);
+            return std::nullopt;
+        }
+        std::string_view text = words[at + 1].text;
+        if (text.starts_with("0x") || text.starts_with("0X"))
+            text.remove_prefix(2);
+        size_t count = 0;
+        auto [end, result] =
+            std::from_chars(text.data(), text.data() + text.size(), count, 16);
+        if (text.empty() || result != std::errc() ||
+            end != text.data() + text.size() || count > 0xFFFF) {
+            error(origin, words[at + 1],
+                  "Repeat count is not a hexadecimal integer up to FFFF!",
+                  line);
+            return std::nullopt;
+        }
+        return count;
+    }
+
+    // Feeds body count times, or until the outermost .rept has produced
+    // maxRepeatedLines, which nested counts of FFFF reach long before they
+    // finish.
+    void repeat(std::span<const std::string_view> body,
+                size_t count,
+                Origin first,
+                const IncludedFile* file,
+                Origin origin,
+                const Token& token,
+                std::string_view line) {
+        bool outermost = !repeatStart.has_value();
+        if (outermost)
+            repeatStart = fed;
+        for (size_t r = 0; r < count && !repeatStopped; r++) {
+            if (fed - *repeatStart > maxRepeatedLines) {
+                error(origin, token,
+                      ".rept expands to more than " +
+                          std::to_string(maxRepeatedLines) + " lines!",
+                      line);
+                repeatStopped = true;
+            } else
+                processBlock(body, first, file);
+        }
+        if (outermost) {
+            repeatStart.reset();
+            repeatStopped = false;
+        }
+    }
+
+    void include(const Words& words,
+                 size_t at,
+                 Origin origin,
+                 std::string_view line) {
+        std::string_view name = Directives::includeName(line, words, at);
+        if (name.empty()) {
+            error(origin, words[at], "Expected a file name after .include!",
+                  line);
+            return;
+        }
+
+        std::filesystem::path base =
+            includeStack.empty()
+                ? directory
+                : std::filesystem::path(includeStack.back()->path)
+                      .parent_path();
+        std::shared_ptr<const IncludedFile> file;
+        try {
+            file = cache.load(base / name);
+        } catch (const std::runtime_error& e) {
+            error(origin, words[at + 1], e.what(), line);
+            return;
+        }
+        bool cycle = file->canonical == canonical;
+        for (const IncludedFile* open : includeStack)
+            cycle = cycle || open->canonical == file->canonical;
+        if (cycle) {
+            error(origin, words[at + 1], file->path + " includes itself!",
+                  line);
+            return;
+        }
+
+        included.push_back(file);
+        includeStack.push_back(file.get());
+        processBlock(file->lines, {&file->path, 1, -1}, file.get());
+        includeStack.pop_back();
+    }
+
+    void expand(const Macro& macro,
+                const Words& words,
+                size_t at,
+                Origin origin,
+                std::string_view line) {
+        size_t count = words.size() - at - 1;
+        if (count != macro.parameters.size()) {
+            error(origin, words[at],
+                  "Wrong number of arguments for macro " + macro.name + "! " +
+                      std::to_string(count) + " provided, but " +
+                      std::to_string(macro.parameters.size()) + " needed.",
+                  line);
+            return;
+        }
+        if (depth == maxDepth) {
+            error(origin, words[at],
+                  "Macro " + macro.name + " is expanded more than " +
+                      std::to_string(maxDepth) + " levels deep!",
+                  line);
+            return;
+        }
+
+        // One expansion at a time is materialized, never the whole output.
+        std::string counter = std::to_string(++expansions);
+        std::string text;
+        std::vector<size_t> ends;
+        text.reserve(macro.body.size() + macro.lineEnds.size());
+        size_t piece = 0;
+        for (uint32_t end : macro.lineEnds) {
+            for (; piece < end; piece++) {
+                const Macro::Piece& p = macro.pieces[piece];
+                if (p.parameter == Macro::TEXT)
+                    text.append(macro.body, p.offset, p.length);
+                else if (p.parameter == Macro::COUNTER)
+                    text += counter;
+                else
+                    text += words[at + 1 + p.parameter].text;
+            }
+            ends.push_back(text.size());
+        }
+        std::vector<std::string_view> lines;
+        lines.reserve(ends.size());
+        for (size_t i = 0, start = 0; i < ends.size(); start = ends[i++])
+            lines.push_back(std::string_view(text).substr(start,
+                                                          ends[i] - start));
+
+        int32_t expansion = lineMap.addExpansion(macro.name, origin);
+        depth++;
+        processBlock(lines, {macro.file, macro.line + 1, expansion}, nullptr);
+        depth--;
+    }
+
+    // A line that neither opens nor needs a block: passes through, or is
+    // an .include, a macro invocation or a stray closing directive.
+    void handle(std::string_view line,
+                const Words& words,
+                Directives::Kind kind,
+                Origin origin) {
+        size_t at = Directives::head(words);
+        const Macro* macro = kind == Directives::NONE ? findMacro(words, at)
+                                                      : nullptr;
+        if (kind == Directives::NONE && macro == nullptr) {
+            emit(line, origin);
+            return;
+        }
+        if (at == 1)
+            emit(words[0].text, origin);
+        if (macro != nullptr)
+            expand(*macro, words, at, origin, line);
+        else if (kind == Directives::INCLUDE)
+            include(words, at, origin, line);
+        else if (kind == Directives::ENDM)
+            error(origin, words[at], ".endm without .macro!", line);
+        else if (kind == Directives::ENDR)
+            error(origin, words[at], ".endr without .rept!", line);
+    }
+
+    // Lines whose blocks are all at hand: an included file, a macro
+    // expansion or a .rept body. lines[i] comes from line first.line + i.
+    // file is set when lines are part of that file, whose macros are then
+    // already parsed.
+    void processBlock(std::span<const std::string_view> lines,
+                      Origin first,
+                      const IncludedFile* file) {
+        Words words;
+        for (size_t i = 0; i < lines.size(); i++) {
+            std::string_view line = lines[i];
+            Origin origin{first.file, first.line + i, first.expansion};
+            if (plain(line)) {
+                emit(line, origin);
+                continue;
+            }
+            Directives::Kind kind = Directives::classify(line, words);
+            if (kind != Directives::MACRO && kind != Directives::REPT) {
+                handle(line, words, kind, origin);
+                continue;
+            }
+
+            size_t at = Directives::head(words);
+            if (at == 1)
+                emit(words[0].text, origin);
+            size_t end = Directives::findEnd(lines, i, kind);
+            if (end == lines.size()) {
+                error(origin, words[at],
+                      kind == Directives::MACRO ? "Missing .endm for .macro!"
+                                                : "Missing .endr for .rept!",
+                      line);
+                return;
+            }
+            std::span<const std::string_view> body =
+                lines.subspan(i + 1, end - i - 1);
+            if (kind == Directives::MACRO) {
+                const IncludedFile::Definition* definition = nullptr;
+                if (file != nullptr) {
+                    auto found = file->definitions.find(origin.line - 1);
+                    if (found != file->definitions.end())
+                        definition = &found->second;
+                }
+                PreprocessorError problem;
+                std::shared_ptr<const Macro> macro =
+                    definition != nullptr
+                        ? definition->macro
+                        : Macro::define(words, at, body, origin.file,
+                                        origin.line, problem);
+                if (definition != nullptr && definition->error.has_value())
+                    problem = *definition->error;
+                if (macro != nullptr)
+                    define(macro, origin, words, line);
+                else
+                    reportDefinition(problem, origin, lines[i + problem.line]);
+            } else if (std::optional<size_t> count =
+                           repeatCount(words, at, origin, line)) {
+                repeat(body, *count,
+                       {origin.file, origin.line + 1, origin.expansion}, file,
+                       origin, words[at], line);
+            }
+            i = end;
+        }
+    }
+
+    void collect(std::string_view line) {
+        blockStarts.push_back(block.size());
+        block += line;
+    }
+
+    // Closes the main source's open block, collected from the lines after
+    // headerLine.
+    void close() {
+        State closed = state;
+        state = State::NORMAL;
+        std::vector<std::string_view> lines;
+        lines.reserve(blockStarts.size());
+        for (size_t i = 0; i < blockStarts.size(); i++)
+            lines.push_back(std::string_view(block).substr(
+                blockStarts[i],
+                (i + 1 < blockStarts.size() ? blockStarts[i + 1]
+                                            : block.size()) -
+                    blockStarts[i]));
+        Words words;
+        Directives::split(header, words);
+        size_t at = Directives::head(words);
+        Origin origin{&sourceName, headerLine, -1};
+
+        if (closed == State::MACRO) {
+            PreprocessorError problem;
+            std::shared_ptr<const Macro> macro = Macro::define(
+                words, at, lines, &sourceName, headerLine, problem);
+            if (macro != nullptr)
+                define(macro, origin, words, header);
+            else
+                reportDefinition(problem, origin,
+                                 problem.line == 0 ? std::string_view(header)
+                                                   : lines[problem.line - 1]);
+        } else if (std::optional<size_t> count =
+                       repeatCount(words, at, origin, header)) {
+            repeat(lines, *count, {&sourceName, headerLine + 1, -1}, nullptr,
+                   origin, words[at], header);
+        }
+    }
+
+  public:
+    // Relative includes of the main source are looked up next to
+    // sourceName; sink receives every line the assembler should see.
+    Preprocessor(std::string sourceName,
+                 Diagnostics& diagnostics,
+                 Sink sink,
+                 IncludeCache& cache = IncludeCache::shared())
+        : sourceName(std::move(sourceName)),
+          directory(std::filesystem::path(this->sourceName).parent_path()),
+          diagnostics(diagnostics),
+          sink(std::move(sink)),
+          cache(cache) {
+        std::error_code error;
+        if (this->sourceName != "-")
+            canonical = std::filesystem::canonical(this->sourceName, error);
+    }
+
+    // Diagnostics and the line map point into this object.
+    Preprocessor(const Preprocessor&) = delete;
+    Preprocessor& operator=(const Preprocessor&) = delete;
+
+    // Line lineNumber of the main source.
+    void feed(std::string_view line, size_t lineNumber) {
+        Origin origin{&sourceName, lineNumber, -1};
+        if (state == State::NORMAL) {
+            if (plain(line)) {
+                emit(line, origin);
+                return;
+            }
+            Directives::Kind kind = Directives::classify(line, words);
+            if (kind != Directives::MACRO && kind != Directives::REPT) {
+                handle(line, words, kind, origin);
+                return;
+            }
+            if (Directives::head(words) == 1)
+                emit(words[0].text, origin);
+            state = kind == Directives::MACRO ? State::MACRO : State::REPT;
+            header = line;
+            headerLine = lineNumber;
+            nesting = 0;
+            block.clear();
+            blockStarts.clear();
+            return;
+        }
+
+        Directives::Kind kind = Directives::classify(line, words);
+        bool closes = state == State::MACRO ? kind == Directives::ENDM
+                                            : kind == Directives::ENDR &&
+                                                  nesting == 0;
+        if (!closes) {
+            if (state == State::REPT && kind == Directives::REPT)
+                nesting++;
+            else if (state == State::REPT && kind == Directives::ENDR)
+                nesting--;
+            collect(line);
+            return;
+        }
+        if (Directives::head(words) == 1)
+            collect(words[0].text);
+        close();
+    }
+
+    // Reports a block the main source left open.
+    void finish() {
+        if (state == State::NORMAL)
+            return;
+        Words words;
+        Directives::split(header, words);
+        error({&sourceName, headerLine, -1}, words[Directives::head(words)],
+              state == State::MACRO ? "Missing .endm for .macro!"
+                                    : "Missing .endr for .rept!",
+              header);
+        state = State::NORMAL;
+    }
+
+    const LineMap& getLineMap() const { return lineMap; }
+
+    // Every file included so far, once per .include.
+    const std::vector<std::shared_ptr<const IncludedFile>>& getIncluded()
+        const {
+        return included;
+    }
+
+    // The files the source at path includes, directly or not, found by
+    // following every .include line without expanding anything. nullopt
+    // when a name cannot be resolved that way, such as one built from a
+    // macro parameter.
+    static std::optional<std::vector<std::shared_ptr<const IncludedFile>>>
+    dependencies(const std::string& path,
+                 std::string_view text,
+                 IncludeCache& cache = IncludeCache::shared()) {
+        std::vector<std::shared_ptr<const IncludedFile>> result;
+        if (text.find(".include") == text.npos)
+            return result;
+        std::unordered_set<std::string> seen;
+        std::vector<std::pair<std::filesystem::path, std::string_view>>
+            pending{{std::filesystem::path(path).parent_path(), text}};
+        Words words;
+        while (!pending.empty()) {
+            auto [base, source] = pending.back();
+            pending.pop_back();
+            bool failed = false;
+            forEachLine(source, [&](std::string_view line, size_t) {
+                if (failed ||
+                    Directives::classify(line, words) != Directives::INCLUDE)
+                    return;
+                std::string_view name = Directives::includeName(
+                    line, words, Directives::head(words));
+                if (name.empty() || name.find('\\') != name.npos) {
+                    failed = true;
+                    return;
+                }
+                try {
+                    std::shared_ptr<const IncludedFile> file =
+                        cache.load(base / name);
+                    if (seen.insert(file->canonical.string()).second) {
+                        result.push_back(file);
+                        pending.push_back(
+                            {file->canonical.parent_path(), file->text});
+                    }
+                } catch (const std::runtime_error&) {
+                    failed = true;
+                }
+            });
+            if (failed)
+                return std::nullopt;
+        }
+        return result;
+    }
+};
+
+#endif  // PREPROCESSOR_HPP
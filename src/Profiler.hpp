@@ -0,0 +1,191 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "Disassembler.hpp"
+#include "Emulator.hpp"
+#include "LineTable.hpp"
+
+// Reads an ExecutionProfile back in terms of the program: hot spots by
+// address, totals per mnemonic, the outcomes of every JFZ, and folded
+// stacks for flamegraph.pl and compatible viewers. With a LineTable from
+// the assembly, addresses are named by their source lines, and each stack
+// runs from the nearest label through the macro expansions down to the
+// line; without one, by address and disassembly only.
+class ProfileReport {
+    struct Spot {
+        uint8_t pc = 0;
+        uint64_t executions = 0;
+        uint64_t cycles = 0;
+    };
+
+    const Emulator& emulator;
+    const ExecutionProfile& profile;
+    const LineTable* lines;
+    Disassembler disassembler;
+    std::vector<Spot> spots;  // executed addresses, most cycles first
+    uint64_t totalCycles = 0;
+
+    std::string instruction(uint8_t pc) const {
+        const CpuState& cpu = emulator.state();
+        Disassembler::Instruction decoded =
+            disassembler.decode(cpu.memory, pc);
+        return decoded.valid ? decoded.text : "???";
+    }
+
+    const LineTable::Entry* entry(uint8_t pc) const {
+        return lines != nullptr ? lines->find(pc) : nullptr;
+    }
+
+    // "file:line", with the macro it was expanded from.
+    std::string source(uint8_t pc) const {
+        const LineTable::Entry* found = entry(pc);
+        if (found == nullptr)
+            return {};
+        std::string result = lines->describe(*found);
+        if (found->expansion >= 0) {
+            const LineTable::Expansion& expansion =
+                lines->expansion(found->expansion);
+            result += " in " + expansion.macro + " at " +
+                      lines->file(expansion.file) + ":" +
+                      std::to_string(expansion.line);
+        }
+        return result;
+    }
+
+    static std::string percent(uint64_t part, uint64_t total) {
+        char text[16];
+        std::snprintf(text, sizeof(text), "%5.1f%%",
+                      total == 0 ? 0.0 : 100.0 * part / total);
+        return text;
+    }
+
+    // Folded-stack frames may hold anything but the separator.
+    static std::string frame(std::string text) {
+        std::replace(text.begin(), text.end(), ';', ':');
+        return text;
+    }
+
+  public:
+    ProfileReport(const Emulator& emulator,
+                  const ExecutionProfile& profile,
+                  const LineTable* lines = nullptr)
+        : emulator(emulator), profile(profile), lines(lines) {
+        for (size_t pc = 0; pc < profile.executions.size(); pc++) {
+            if (profile.executions[pc] == 0)
+                continue;
+            uint64_t cycles = profile.executions[pc] *
+                              emulator.decodedAt(pc).length;
+            spots.push_back({uint8_t(pc), profile.executions[pc], cycles});
+            totalCycles += cycles;
+        }
+        std::stable_sort(spots.begin(), spots.end(),
+                         [](const Spot& a, const Spot& b) {
+                             return a.cycles > b.cycles;
+                         });
+    }
+
+    // The limit most expensive addresses, then every mnemonic and JFZ.
+    std::string text(size_t limit = 20) const {
+        std::string result = "Hot spots:\n";
+        char line[96];
+        std::snprintf(line, sizeof(line), "  %-4s %12s %12s %6s  %-16s %s\n",
+                      "PC", "executions", "cycles", "", "instruction",
+                      lines != nullptr ? "source" : "");
+        result += line;
+        for (size_t i = 0; i < spots.size() && i < limit; i++) {
+            const Spot& spot = spots[i];
+            std::snprintf(line, sizeof(line), "  %02X   %12llu %12llu %s  %-16s ",
+                          spot.pc, (unsigned long long)spot.executions,
+                          (unsigned long long)spot.cycles,
+                          percent(spot.cycles, totalCycles).c_str(),
+                          instruction(spot.pc).c_str());
+            result += line + source(spot.pc);
+            while (result.back() == ' ')
+                result.pop_back();
+            result += '\n';
+        }
+
+        std::map<std::string, Spot> mnemonics;
+        for (const Spot& spot : spots) {
+            Spot& total =
+                mnemonics[microOpMnemonics[emulator.decodedAt(spot.pc).op]];
+            total.executions += spot.executions;
+            total.cycles += spot.cycles;
+        }
+        result += "Mnemonics:\n";
+        for (const auto& [name, total] : mnemonics) {
+            std::snprintf(line, sizeof(line), "  %-4s %12llu %12llu %s\n",
+                          name.c_str(), (unsigned long long)total.executions,
+                          (unsigned long long)total.cycles,
+                          percent(total.cycles, totalCycles).c_str());
+            result += line;
+        }
+
+        bool header = false;
+        for (size_t pc = 0; pc < profile.executions.size(); pc++) {
+            MicroOp op = emulator.decodedAt(pc).op;
+            if (profile.executions[pc] == 0 ||
+                (op != OP_JFZ_ACC && op != OP_JFZ_REG))
+                continue;
+            if (!header) {
+                std::snprintf(line, sizeof(line), "JFZ:\n  %-4s %12s %12s\n",
+                              "PC", "taken", "not taken");
+                result += line;
+                header = true;
+            }
+            std::snprintf(line, sizeof(line), "  %02zX   %12llu %12llu  ", pc,
+                          (unsigned long long)profile.taken[pc],
+                          (unsigned long long)(profile.executions[pc] -
+                                               profile.taken[pc]));
+            result += line + source(pc);
+            while (result.back() == ' ')
+                result.pop_back();
+            result += '\n';
+        }
+        return result;
+    }
+
+    // One line per executed address: its frames joined by ';', a space and
+    // its cycles, the input flamegraph.pl expects.
+    std::string folded() const {
+        std::vector<std::string> stacks;
+        for (const Spot& spot : spots) {
+            std::string stack;
+            const LineTable::Entry* found = entry(spot.pc);
+            if (found != nullptr) {
+                const LineTable::Label* label = lines->labelBefore(spot.pc);
+                stack = frame(label != nullptr ? label->name : "<start>");
+                std::vector<std::string> macros;
+                for (int32_t i = found->expansion; i >= 0;
+                     i = lines->expansion(i).parent) {
+                    const LineTable::Expansion& expansion = lines->expansion(i);
+                    macros.push_back(expansion.macro + " (" +
+                                     lines->file(expansion.file) + ":" +
+                                     std::to_string(expansion.line) + ")");
+                }
+                for (auto macro = macros.rbegin(); macro != macros.rend();
+                     ++macro)
+                    stack += ";" + frame(*macro);
+                stack += ";" + frame(lines->describe(*found) + " " +
+                                     instruction(spot.pc));
+            } else {
+                char address[8];
+                std::snprintf(address, sizeof(address), "%02X ", spot.pc);
+                stack = frame(address + instruction(spot.pc));
+            }
+            stacks.push_back(stack + " " + std::to_string(spot.cycles));
+        }
+        std::sort(stacks.begin(), stacks.end());
+        std::string result;
+        for (const std::string& stack : stacks)
+            result += stack + "\n";
+        return result;
+    }
+};
+
+#endif  // PROFILER_HPP
@@ -0,0 +1,93 @@
+#ifndef SOURCEFILE_HPP
+#define SOURCEFILE_HPP
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ASMZ_HAS_MMAP 1
+#endif
+
+// Whole-file view of a regular source file. Uses mmap where available and a
+// single bulk read otherwise; either way the text stays put for the lifetime
+// of the object, so tokens can point straight into it.
+class SourceFile {
+    const char* mapping = nullptr;
+    size_t mappedSize = 0;
+    std::string buffer;
+
+    void readWhole(const std::string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            throw std::runtime_error("Cannot open " + path + "!");
+        buffer.resize(file.tellg());
+        file.seekg(0);
+        file.read(buffer.data(), buffer.size());
+    }
+
+  public:
+    explicit SourceFile(const std::string& path) {
+#ifdef ASMZ_HAS_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open " + path + "!");
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* address = ::mmap(nullptr, info.st_size, PROT_READ,
+                                   MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                ::madvise(address, info.st_size, MADV_SEQUENTIAL);
+                mapping = static_cast<const char*>(address);
+                mappedSize = info.st_size;
+            }
+        }
+        ::close(fd);
+        if (mapping == nullptr)
+            readWhole(path);
+#else
+        readWhole(path);
+#endif
+    }
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    ~SourceFile() {
+#ifdef ASMZ_HAS_MMAP
+        if (mapping != nullptr)
+            ::munmap(const_cast<char*>(mapping), mappedSize);
+#endif
+    }
+
+    std::string_view text() const {
+        if (mapping != nullptr)
+            return {mapping, mappedSize};
+        return buffer;
+    }
+};
+
+// Calls callback(line, lineNumber) for every line of text, without the
+// newline, splitting the same way getline does. memchr is the vectorized
+// newline scan: libc implements it with SSE2/AVX2 on x86-64.
+template <typename Callback>
+void forEachLine(std::string_view text, Callback&& callback) {
+    const char* cursor = text.data();
+    const char* end = cursor + text.size();
+    size_t lineNumber = 0;
+    while (cursor < end) {
+        const char* newline =
+            static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+        const char* lineEnd = newline != nullptr ? newline : end;
+        callback(std::string_view(cursor, lineEnd - cursor), ++lineNumber);
+        cursor = lineEnd + 1;
+    }
+}
+
+#endif  // SOURCEFILE_HPP
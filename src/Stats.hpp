@@ -0,0 +1,108 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "CompilerConfig.hpp"
+
+// Where one assembly spent its time, and what it produced. Filled in by
+// Translator and Assembler when --stats is given; nothing is measured
+// otherwise. Each stage of each line is timed separately, so the clock
+// reads make a --stats run slower than a plain one.
+struct AssemblyStats {
+    enum Stage {
+        READING,  // opening or mapping the source, reading piped lines
+        TOKENIZING,
+        PARSING,  // labels, mnemonic lookup and operand parsing
+        VALIDATING,
+        EMITTING,  // encoding, the optimizer and label patching
+        WRITING,  // rendering the output format and writing the file
+        STAGE_COUNT
+    };
+
+    static constexpr std::array<const char*, STAGE_COUNT> stageNames = {
+        "reading", "tokenizing", "parsing", "validating", "emitting",
+        "writing"};
+
+    std::array<std::chrono::nanoseconds, STAGE_COUNT> time{};
+    size_t lines = 0;
+    std::array<size_t, HLT + 1> instructions{};  // emitted, by CommandType
+    size_t bytesEmitted = 0;
+    size_t paddingBytes = 0;
+
+    // Adds the lifetime of the timer to one stage; a null stats pointer
+    // makes it a no-op.
+    class Timer {
+        AssemblyStats* stats;
+        Stage stage;
+        std::chrono::steady_clock::time_point start;
+
+      public:
+        Timer(AssemblyStats* stats, Stage stage) : stats(stats), stage(stage) {
+            if (stats != nullptr)
+                start = std::chrono::steady_clock::now();
+        }
+        ~Timer() {
+            if (stats != nullptr)
+                stats->time[stage] += std::chrono::steady_clock::now() - start;
+        }
+    };
+
+    std::string report() const {
+        std::string result;
+        char line[64];
+        std::chrono::nanoseconds total{};
+        for (size_t stage = 0; stage < STAGE_COUNT; stage++) {
+            std::snprintf(line, sizeof(line), "%-11s %10.3f ms\n",
+                          stageNames[stage], time[stage].count() / 1e6);
+            result += line;
+            total += time[stage];
+        }
+        std::snprintf(line, sizeof(line), "%-11s %10.3f ms\n", "total",
+                      total.count() / 1e6);
+        result += line;
+
+        result += "Lines: " + std::to_string(lines) + "\n";
+        result += "Instructions:";
+        for (size_t type = 0; type < instructions.size(); type++)
+            if (instructions[type] != 0)
+                result += " " + mnemonic(type) + "=" +
+                          std::to_string(instructions[type]);
+        result += "\nBytes emitted: " + std::to_string(bytesEmitted) +
+                  ", padding: " + std::to_string(paddingBytes) + "\n";
+        return result;
+    }
+
+    // Same as report(), as a single JSON object with times in nanoseconds.
+    std::string json() const {
+        std::string result = "{\"time_ns\": {";
+        for (size_t stage = 0; stage < STAGE_COUNT; stage++)
+            result += std::string(stage == 0 ? "" : ", ") + "\"" +
+                      stageNames[stage] +
+                      "\": " + std::to_string(time[stage].count());
+        result += "}, \"lines\": " + std::to_string(lines) +
+                  ", \"instructions\": {";
+        bool first = true;
+        for (size_t type = 0; type < instructions.size(); type++) {
+            if (instructions[type] == 0)
+                continue;
+            result += std::string(first ? "" : ", ") + "\"" + mnemonic(type) +
+                      "\": " + std::to_string(instructions[type]);
+            first = false;
+        }
+        result += "}, \"bytes_emitted\": " + std::to_string(bytesEmitted) +
+                  ", \"padding_bytes\": " + std::to_string(paddingBytes) +
+                  "}\n";
+        return result;
+    }
+
+  private:
+    static std::string mnemonic(size_t type) {
+        return std::string(
+            CompilerConfig::commands.getByType(CommandType(type))->name);
+    }
+};
+
+#endif  // STATS_HPP
@@ -0,0 +1,73 @@
+#ifndef SYMBOLTABLE_HPP
+#define SYMBOLTABLE_HPP
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Lexer.hpp"
+
+struct Symbol {
+    std::string name;
+    size_t address = 0;
+    bool defined = false;
+    SourcePosition definition;
+};
+
+// Label name -> address. Symbols are stored densely and referenced by index
+// so fixups stay small; lookups hash the string_view directly, so a
+// reference to a known label does not allocate.
+class SymbolTable {
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    std::vector<Symbol> symbols;
+    std::unordered_map<std::string, size_t, NameHash, std::equal_to<>> indices;
+
+  public:
+    // Returns the index of name, adding it as undefined on first use.
+    size_t intern(std::string_view name) {
+        auto iterator = indices.find(name);
+        if (iterator != indices.end())
+            return iterator->second;
+        symbols.push_back({std::string(name), 0, false, {}});
+        indices.emplace(symbols.back().name, symbols.size() - 1);
+        return symbols.size() - 1;
+    }
+
+    // Returns the index of the newly defined name.
+    size_t define(std::string_view name,
+                  size_t address,
+                  SourcePosition position) {
+        size_t index = intern(name);
+        Symbol& symbol = symbols[index];
+        if (symbol.defined)
+            throw std::runtime_error(
+                "Label " + symbol.name + " is already defined at line " +
+                std::to_string(symbol.definition.line) + "!");
+        symbol.address = address;
+        symbol.defined = true;
+        symbol.definition = position;
+        return index;
+    }
+
+    void setAddress(size_t index, size_t address) {
+        symbols[index].address = address;
+    }
+
+    void clear() {
+        symbols.clear();
+        indices.clear();
+    }
+
+    const Symbol& operator[](size_t index) const { return symbols[index]; }
+    size_t size() const { return symbols.size(); }
+};
+
+#endif  // SYMBOLTABLE_HPP
@@ -1,11 +1,19 @@
 #ifndef TYPES_HPP
 #define TYPES_HPP
 
+#include <array>
+#include <bit>
+#include <climits>
+#include <cstdint>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
-#include <vector>
+#include <string_view>
+#include <utility>
 
 enum OperandType {
+    NONE = 0b00000000,  // an absent operand, only used to index encoders
     ACCUMULATOR = 0b00000001,
     REGISTER = 0b00000010,
     LITERAL = 0b00000100
@@ -28,47 +36,174 @@ enum CommandType {
     HLT
 };
 
+// A literal operand may also name a label (see SymbolTable). It is then
+// encoded as 0 and patched once the label's address is known.
 struct Operand {
-    OperandType type;
-    unsigned char value;
-    Operand(std::string string) {
+    OperandType type = NONE;
+    unsigned char value = 0;
+    std::string_view symbol;
+
+    constexpr Operand() = default;
+    constexpr Operand(std::string_view string) {
+        if (const char* error = parse(string, *this))
+            throw std::runtime_error(error);
+    }
+
+    // Parses string into result without throwing: returns what is wrong
+    // with it, or nullptr.
+    static constexpr const char* parse(std::string_view string,
+                                       Operand& result) {
+        result = Operand();
+        if (string.empty())
+            return "Empty operand!";
+        std::optional<unsigned int> literal;
         if (string == "A")
-            type = ACCUMULATOR;
-        else if (string[0] == 'R') {
-            type = REGISTER;
-            int literal = std::stoi(string.data() + 1, 0, 16);
-            if (literal >= 0 && literal < 256)
-                value = literal;
-            else
-                throw std::runtime_error(
-                    "Register number is not hexadecimal 8-bit integer!");
-        } else {
-            int literal = std::stoi(string, 0, 16);
-            if (literal >= 0 && literal < 256)
-                value = literal;
+            result.type = ACCUMULATOR;
+        else if (string[0] == 'R' && (literal = parseHex(string.substr(1)))) {
+            if (*literal >= 256)
+                return "Register number is not hexadecimal 8-bit integer!";
+            result.type = REGISTER;
+            result.value = *literal;
+        } else if ((literal = parseHex(string))) {
+            if (*literal >= 256)
+                return "Literal is not hexadecimal 8-bit integer!";
+            result.type = LITERAL;
+            result.value = *literal;
+        } else if (isSymbolName(string)) {
+            result.type = LITERAL;
+            result.symbol = string;
+        } else
+            return "Literal is not hexadecimal 8-bit integer!";
+        return nullptr;
+    }
+
+    // Identifiers that cannot be mistaken for A, a register or a literal.
+    static constexpr bool isSymbolName(std::string_view string) {
+        auto identifierChar = [](char c, bool first) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                   c == '_' || c == '.' || (!first && c >= '0' && c <= '9');
+        };
+        if (string.empty() || string == "A" || parseHex(string) ||
+            (string[0] == 'R' && parseHex(string.substr(1))))
+            return false;
+        for (size_t i = 0; i < string.size(); i++)
+            if (!identifierChar(string[i], i == 0))
+                return false;
+        return true;
+    }
+
+  private:
+    // Hand-rolled rather than std::from_chars so operands can be parsed in
+    // constant expressions (see Firmware.hpp).
+    static constexpr std::optional<unsigned int> parseHex(
+        std::string_view string) {
+        if (string.starts_with("0x") || string.starts_with("0X"))
+            string.remove_prefix(2);
+        if (string.empty())
+            return std::nullopt;
+        unsigned int literal = 0;
+        for (char c : string) {
+            unsigned int digit;
+            if (c >= '0' && c <= '9')
+                digit = c - '0';
+            else if (c >= 'a' && c <= 'f')
+                digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                digit = c - 'A' + 10;
             else
-                throw std::runtime_error(
-                    "Literal is not hexadecimal 8-bit integer!");
-            type = LITERAL;
+                return std::nullopt;
+            literal = literal > 0xFFFF ? UINT_MAX : literal * 16 + digit;
         }
+        return literal;
     }
 };
 
+// One encoded instruction, opcode byte included. No AsmZ instruction is
+// longer than three bytes.
+struct Encoding {
+    std::array<uint8_t, 3> bytes{};
+    uint8_t size = 0;
+
+    constexpr void push(unsigned int byte) { bytes[size++] = uint8_t(byte); }
+};
+
+using Encoder = Encoding (*)(std::span<const Operand>);
+
+// Operand-type combinations index a 4x4 table: none, accumulator,
+// register, literal for each of the (at most) two operands.
+constexpr size_t operandKind(OperandType type) {
+    return type == NONE ? 0 : std::countr_zero(unsigned(type)) + 1;
+}
+
+constexpr OperandType operandTypeOfKind(size_t kind) {
+    return kind == 0 ? NONE : OperandType(1u << (kind - 1));
+}
+
+constexpr size_t encoderIndex(OperandType first, OperandType second) {
+    return operandKind(first) * 4 + operandKind(second);
+}
+
+// Descriptors are literal types so the instruction set can be inspected and
+// used at compile time (see CommandRegistry and Firmware.hpp). Each command
+// supplies encode<First, Second>() and bindEncoders() instantiates it for
+// every operand-type combination the descriptor accepts, so encoding is a
+// table lookup into a function specialized for exactly those operands.
 struct CommandDescriptor {
     CommandType type;
-    std::string name;
+    std::string_view name;
     char code;
 
     size_t opcount;
-    std::vector<char> suitableOperandTypes;
+    std::array<char, 2> suitableOperandTypes{};
+    std::array<Encoder, 16> encoders{};
 
-    virtual std::vector<char> compile(std::vector<Operand>&) const = 0;
-    virtual ~CommandDescriptor() = default;
-};
+    // Throws for a combination accepts() rejects, which makes constant
+    // evaluation fail at the throw.
+    constexpr Encoding encode(std::span<const Operand> operands) const {
+        Encoder encoder = encoders[indexOf(operands)];
+        if (encoder == nullptr)
+            throw std::runtime_error("Invalid operands for " +
+                                     std::string(name) + "!");
+        return encoder(operands);
+    }
+
+    // Whether some addressing mode encodes this combination of operand
+    // types. Each operand can suit its slot while the pair does not, like
+    // the accumulator with a literal in ADD.
+    constexpr bool accepts(std::span<const Operand> operands) const {
+        return encoders[indexOf(operands)] != nullptr;
+    }
+
+  protected:
+    static constexpr size_t indexOf(std::span<const Operand> operands) {
+        OperandType first = operands.size() > 0 ? operands[0].type : NONE;
+        OperandType second = operands.size() > 1 ? operands[1].type : NONE;
+        return encoderIndex(first, second);
+    }
 
-struct Expression {
-    const CommandDescriptor* command;
-    std::vector<Operand> operands;
+    // Combinations an encoder returns no bytes for have no addressing mode
+    // and stay unbound.
+    template <typename Command>
+    constexpr void bindEncoders() {
+        constexpr auto all = []<size_t... I>(std::index_sequence<I...>) {
+            return std::array<Encoder, 16>{
+                &Command::template encode<operandTypeOfKind(I / 4),
+                                          operandTypeOfKind(I % 4)>...};
+        }(std::make_index_sequence<16>());
+
+        for (size_t i = 0; i < all.size(); i++) {
+            OperandType first = operandTypeOfKind(i / 4);
+            OperandType second = operandTypeOfKind(i % 4);
+            bool accepted = (opcount == 0 && first == NONE && second == NONE) ||
+                            (opcount == 1 && second == NONE &&
+                             (first & suitableOperandTypes[0])) ||
+                            (opcount == 2 && (first & suitableOperandTypes[0]) &&
+                             (second & suitableOperandTypes[1]));
+            constexpr std::array<Operand, 2> probe{};
+            if (accepted && all[i](probe).size != 0)
+                encoders[i] = all[i];
+        }
+    }
 };
 
 #endif  // TYPES_HPP
@@ -0,0 +1,121 @@
+#ifndef WATCH_HPP
+#define WATCH_HPP
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "Incremental.hpp"
+#include "OutputFormat.hpp"
+#include "SourceFile.hpp"
+#include "Translator.hpp"
+
+// Reassembles one source file every time it changes on disk, until the
+// process is killed. The file is polled for a new modification time or
+// size; each change goes through an IncrementalAssembler, and the output
+// file is patched in place when the image keeps its size and the format
+// gives every byte a fixed place, and rewritten otherwise.
+class SourceWatcher {
+    static constexpr std::chrono::milliseconds pollInterval{20};
+
+    std::string inputPath;
+    std::filesystem::path outputPath;
+    OutputFormat format;
+    IncrementalAssembler assembler;
+    std::optional<size_t> writtenSize;  // of the image in the output file
+
+    struct Stamp {
+        std::filesystem::file_time_type time;
+        uintmax_t size = 0;
+
+        bool operator==(const Stamp&) const = default;
+    };
+
+    Stamp stamp() const {
+        std::error_code error;
+        Stamp result{std::filesystem::last_write_time(inputPath, error),
+                     std::filesystem::file_size(inputPath, error)};
+        return result;
+    }
+
+    void write(const IncrementalAssembler::Update& update) {
+        const std::vector<uint8_t>& image = assembler.getImage();
+        std::optional<size_t> width = ImageEncoder::byteWidth(format);
+        if (width.has_value() && writtenSize == image.size()) {
+            if (update.firstByte >= update.endByte)
+                return;
+            std::string bytes = ImageEncoder::encode(
+                format, std::span(image).subspan(
+                            update.firstByte,
+                            update.endByte - update.firstByte));
+            std::fstream file(outputPath, std::ios::binary | std::ios::in |
+                                              std::ios::out);
+            file.seekp(update.firstByte * *width);
+            file.write(bytes.data(), bytes.size());
+            if (file)
+                return;
+        }
+        std::string bytes = ImageEncoder::encode(format, image);
+        std::ofstream file(outputPath, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), bytes.size());
+        if (!file)
+            throw std::runtime_error("Cannot write " + outputPath.string() +
+                                     "!");
+        writtenSize = image.size();
+    }
+
+    void rebuild(std::ostream& log) {
+        auto start = std::chrono::steady_clock::now();
+        SourceFile source(inputPath);
+        IncrementalAssembler::Update update =
+            assembler.update(std::string(source.text()));
+        if (update.firstLine == 0 && writtenSize.has_value())
+            return;
+        write(update);
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        char line[160];
+        std::snprintf(line, sizeof(line),
+                      "%s:%zu: %zu lines reparsed, %s %zu bytes from 0x%zx "
+                      "in %.3f ms.\n",
+                      inputPath.c_str(), update.firstLine, update.addedLines,
+                      update.relaidOut ? "laid out" : "patched",
+                      update.endByte - update.firstByte, update.firstByte,
+                      elapsed.count());
+        log << line << std::flush;
+    }
+
+  public:
+    SourceWatcher(const std::string& inputPath,
+                  const TranslatorOptions& options)
+        : inputPath(inputPath),
+          outputPath(options.resolveOutputPath(inputPath)),
+          format(options.format),
+          assembler(inputPath, options.targetSize) {}
+
+    void run(std::ostream& log, std::ostream& errors) {
+        std::optional<Stamp> built;
+        std::optional<Stamp> previous;
+        while (true) {
+            // Waits for the stamp to hold still for one poll, so a save in
+            // progress is not read half-written.
+            Stamp current = stamp();
+            if (current != built && current == previous) {
+                built = current;
+                try {
+                    rebuild(log);
+                } catch (const std::runtime_error& e) {
+                    errors << e.what() << std::endl;
+                }
+            }
+            previous = current;
+            std::this_thread::sleep_for(pollInterval);
+        }
+    }
+};
+
+#endif  // WATCH_HPP
@@ -0,0 +1,29 @@
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+
+// Google Benchmark's own main, plus --json[=FILE] as a shorthand for the
+// machine-readable output the nightly comparisons consume.
+int main(int argc, char** argv) {
+    std::vector<std::string> storage;
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--json")
+            storage.push_back("--benchmark_format=json");
+        else if (arg.starts_with("--json=")) {
+            storage.push_back("--benchmark_out=" + arg.substr(7));
+            storage.push_back("--benchmark_out_format=json");
+        } else
+            storage.push_back(arg);
+    }
+    std::vector<char*> args;
+    for (std::string& arg : storage)
+        args.push_back(arg.data());
+    int count = args.size();
+
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+}
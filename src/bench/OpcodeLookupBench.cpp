@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "CompilerConfig.hpp"
+
+namespace {
+
+// The linear-scan registry the perfect-hash table replaced, kept as the
+// baseline with the same 15 descriptors main.cpp used to register.
+struct LegacyRegistry {
+    std::vector<const CommandDescriptor*> impl{builtinCommands.begin(),
+                                               builtinCommands.end()};
+
+    const CommandDescriptor* getByName(std::string name, size_t opcount) {
+        auto iterator = std::find_if(
+            impl.begin(), impl.end(), [&](const CommandDescriptor* desc) {
+                return desc->name == name && desc->opcount == opcount;
+            });
+        if (iterator == impl.end())
+            throw std::runtime_error("No such instruction: " + name + "!");
+        return *iterator;
+    }
+};
+
+std::vector<std::pair<std::string, size_t>> lookups() {
+    std::vector<std::pair<std::string, size_t>> result;
+    for (const CommandDescriptor* desc : builtinCommands)
+        result.emplace_back(std::string(desc->name), desc->opcount);
+    return result;
+}
+
+void BM_LegacyGetByName(benchmark::State& state) {
+    LegacyRegistry registry;
+    auto names = lookups();
+    for (auto _ : state) {
+        for (const auto& [name, opcount] : names)
+            benchmark::DoNotOptimize(registry.getByName(name, opcount));
+    }
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+
+void BM_PerfectHashGetByName(benchmark::State& state) {
+    CompilerConfig cfg{};
+    auto names = lookups();
+    for (auto _ : state) {
+        for (const auto& [name, opcount] : names)
+            benchmark::DoNotOptimize(cfg.commands.getByName(name, opcount));
+    }
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+
+}  // namespace
+
+BENCHMARK(BM_LegacyGetByName);
+BENCHMARK(BM_PerfectHashGetByName);
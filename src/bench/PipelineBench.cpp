@@ -0,0 +1,109 @@
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "SourceFile.hpp"
+#include "SourceGenerator.hpp"
+#include "Translator.hpp"
+
+// Per-stage throughput of the assembler over generated programs. Every
+// benchmark reports lines/s as items_per_second and input (or, for the
+// output encoders, image) bytes/s as bytes_per_second.
+namespace {
+
+const std::string& source(size_t lines) {
+    static std::unordered_map<size_t, std::string> cache;
+    auto [iterator, inserted] = cache.try_emplace(lines);
+    if (inserted)
+        iterator->second = SourceGenerator().generate(lines);
+    return iterator->second;
+}
+
+// Runs the pipeline up to the given stage over every line. PARSE fills
+// the Program (parsing and validation); COMPILE also lays it out and
+// encodes it.
+enum Stage { TOKENIZE, PARSE, COMPILE };
+
+template <Stage stage>
+void runStages(benchmark::State& state) {
+    const std::string& text = source(state.range(0));
+    TokenList tokens;
+    Assembler assembler;
+    for (auto _ : state) {
+        assembler.reset();
+        forEachLine(text, [&](std::string_view line, size_t lineNumber) {
+            if constexpr (stage == TOKENIZE) {
+                Lexer::tokenize(line, lineNumber, tokens);
+                benchmark::DoNotOptimize(tokens.size());
+            } else
+                assembler.translateLine(line, lineNumber);
+        });
+        if constexpr (stage == COMPILE)
+            assembler.finish();
+        benchmark::DoNotOptimize(assembler.getImage().data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+void BM_Tokenize(benchmark::State& state) {
+    runStages<TOKENIZE>(state);
+}
+void BM_TokenizeParse(benchmark::State& state) {
+    runStages<PARSE>(state);
+}
+void BM_TokenizeParseCompile(benchmark::State& state) {
+    runStages<COMPILE>(state);
+}
+
+// The write stage: rendering an image in each output format.
+void BM_Write(benchmark::State& state) {
+    OutputFormat format = OutputFormat(state.range(0));
+    std::vector<uint8_t> image(state.range(1));
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = i * 37;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(ImageEncoder::encode(format, image).data());
+    state.SetBytesProcessed(state.iterations() * image.size());
+}
+
+// Whole in-memory assemblies through the library API, into one reused
+// caller buffer.
+void BM_AssembleMemory(benchmark::State& state) {
+    const std::string& text = source(state.range(0));
+    Assembler assembler;
+    std::vector<uint8_t> buffer(text.size());
+    for (auto _ : state)
+        benchmark::DoNotOptimize(assembler.assemble(text, buffer).data());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+// Whole Translator runs: mapping the file, all stages and the file write.
+void BM_TranslateFile(benchmark::State& state) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::filesystem::path input = directory / "asmz_bench.z";
+    std::ofstream(input, std::ios::binary) << source(state.range(0));
+    TranslatorOptions options;
+    options.outputPath = (directory / "asmz_bench.bin").string();
+    options.format = OutputFormat::BINARY;
+    for (auto _ : state)
+        Translator(input.string(), options).run();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * source(state.range(0)).size());
+}
+
+}  // namespace
+
+BENCHMARK(BM_Tokenize)->Arg(1 << 16);
+BENCHMARK(BM_TokenizeParse)->Arg(1 << 16);
+BENCHMARK(BM_TokenizeParseCompile)->Arg(1 << 16);
+BENCHMARK(BM_Write)
+    ->ArgNames({"format", "bytes"})
+    ->Args({int(OutputFormat::HEX_TEXT), 1 << 16})
+    ->Args({int(OutputFormat::BINARY), 1 << 16})
+    ->Args({int(OutputFormat::INTEL_HEX), 1 << 16})
+    ->Args({int(OutputFormat::LOGISIM), 1 << 16});
+BENCHMARK(BM_AssembleMemory)->Arg(1 << 16);
+BENCHMARK(BM_TranslateFile)->Arg(1 << 16);
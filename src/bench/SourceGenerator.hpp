@@ -0,0 +1,76 @@
+#ifndef SOURCEGENERATOR_HPP
+#define SOURCEGENERATOR_HPP
+
+#include <random>
+#include <string>
+#include <vector>
+#include "Commands.hpp"
+
+// Builds synthetic N-line programs for the benchmarks. The line shapes are
+// derived from builtinCommands: one per operand-type combination a
+// descriptor has an encoder for, so every assemblable form of every
+// mnemonic shows up (PUSH/POP currently accept no combination). Comments,
+// blank lines and label definitions are mixed in like in real sources.
+class SourceGenerator {
+    struct Form {
+        std::string_view mnemonic;
+        OperandType first;
+        OperandType second;
+    };
+
+    std::vector<Form> forms;
+    std::mt19937 random;
+
+    std::string operand(OperandType type) {
+        static const char* digits = "0123456789ABCDEF";
+        switch (type) {
+            case ACCUMULATOR:
+                return "A";
+            case REGISTER:
+                return std::string("R") + digits[random() % 8];
+            default: {
+                unsigned value = random() % 256;
+                return {digits[value >> 4], digits[value & 0xF]};
+            }
+        }
+    }
+
+  public:
+    explicit SourceGenerator(unsigned seed = 42) : random(seed) {
+        for (const CommandDescriptor* desc : builtinCommands)
+            for (size_t i = 0; i < desc->encoders.size(); i++)
+                if (desc->encoders[i] != nullptr)
+                    forms.push_back({desc->name, operandTypeOfKind(i / 4),
+                                     operandTypeOfKind(i % 4)});
+    }
+
+    std::string generate(size_t lines) {
+        std::string source;
+        source.reserve(lines * 16);
+        for (size_t line = 0; line < lines; line++) {
+            switch (random() % 16) {
+                case 0:
+                    source += "// generated comment\n";
+                    continue;
+                case 1:
+                    source += "\n";
+                    continue;
+                case 2:
+                    source += "label" + std::to_string(line) + ": ";
+                    break;
+            }
+            const Form& form = forms[random() % forms.size()];
+            source += form.mnemonic;
+            if (form.first != NONE)
+                source += " " + operand(form.first);
+            if (form.second != NONE)
+                source += ", " + operand(form.second);
+            if (random() % 4 == 0)
+                source += " // trailing comment";
+            source += '\n';
+        }
+        return source;
+    }
+};
+
+#endif  // SOURCEGENERATOR_HPP
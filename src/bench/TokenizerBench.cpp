@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Lexer.hpp"
+#include "Types.hpp"
+
+namespace {
+
+std::string makeSource(size_t lines) {
+    static const char* const sample[] = {
+        "MV R2",          "LDA 01 // inline comment",
+        "MV R0, A",       "ADD A, R0",
+        "INC",            "MV R0, 3F",
+        "SUB R1, R0",     "JFZ A, R1",
+        "// a comment",   "HLT"};
+    std::string source;
+    for (size_t i = 0; i < lines; i++) {
+        source += sample[i % std::size(sample)];
+        source += '\n';
+    }
+    return source;
+}
+
+// Verbatim copy of the tokenizer this lexer replaced, kept as the baseline.
+std::vector<std::string> legacyTokenize(std::string line) {
+    static const std::vector<char> delimiters = {' ', ','};
+    if (line.find("//") != line.npos)
+        line = line.substr(0, line.find("//"));
+    if (line.length() == 0)
+        return {};
+
+    std::vector<std::string> result;
+    size_t lastPosition = 0;
+    for (size_t i = 0; i < line.length(); i++) {
+        if (std::find(delimiters.begin(), delimiters.end(), line[i]) !=
+            delimiters.end()) {
+            if (lastPosition != i)
+                result.push_back(line.substr(lastPosition, i - lastPosition));
+            lastPosition = i + 1;
+        }
+    }
+
+    if (lastPosition != line.length())
+        result.push_back(
+            line.substr(lastPosition, line.length() - lastPosition + 1));
+
+    return result;
+}
+
+void BM_LegacyTokenize(benchmark::State& state) {
+    std::string source = makeSource(state.range(0));
+    for (auto _ : state) {
+        std::istringstream input(source);
+        std::string line;
+        while (getline(input, line)) {
+            std::vector<std::string> tokens = legacyTokenize(line);
+            std::vector<Operand> operands;
+            for (size_t i = 1; i < tokens.size(); i++)
+                operands.push_back({tokens[i]});
+            benchmark::DoNotOptimize(operands.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_LexerTokenize(benchmark::State& state) {
+    std::string source = makeSource(state.range(0));
+    TokenList tokens;
+    std::vector<Operand> operands;
+    for (auto _ : state) {
+        std::string_view rest = source;
+        size_t lineNumber = 0;
+        while (!rest.empty()) {
+            size_t end = rest.find('\n');
+            Lexer::tokenize(rest.substr(0, end), ++lineNumber, tokens);
+            rest.remove_prefix(end == rest.npos ? rest.size() : end + 1);
+
+            operands.clear();
+            for (size_t i = 1; i < tokens.size(); i++)
+                operands.emplace_back(tokens[i].text);
+            benchmark::DoNotOptimize(operands.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+}  // namespace
+
+BENCHMARK(BM_LegacyTokenize)->Arg(1 << 16);
+BENCHMARK(BM_LexerTokenize)->Arg(1 << 16);
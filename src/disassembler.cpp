@@ -0,0 +1,61 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include "Assembler.hpp"
+#include "CLI.hpp"
+#include "Disassembler.hpp"
+#include "OutputFormat.hpp"
+
+static int disassemble(int argc, char* argv[]) {
+    InputInfo info(argc, argv,
+                   {"--format", "--output", "--no-addresses", "--check"});
+    std::ifstream file(info.getInputPath(), std::ios::binary);
+    if (!file)
+        throw std::runtime_error("No such file!");
+    std::string data(std::istreambuf_iterator<char>(file), {});
+
+    OutputFormat format = info.getFlag("--format").has_value()
+                              ? ImageEncoder::parseFormat(
+                                    info.getFlag("--format").value())
+                              : ImageEncoder::detectFormat(data);
+    std::vector<uint8_t> image = ImageEncoder::decode(format, data);
+
+    Disassembler disassembler;
+    std::string source = disassembler.disassemble(
+        image, !info.getFlag("--no-addresses").has_value());
+
+    // Reassembles the listing and compares it with the image byte for
+    // byte.
+    if (info.getFlag("--check").has_value()) {
+        Assembler assembler(info.getInputPath());
+        std::span<const uint8_t> code = assembler.assemble(source);
+        size_t same = 0;
+        while (same < code.size() && same < image.size() &&
+               code[same] == image[same])
+            same++;
+        if (same != code.size() || same != image.size()) {
+            std::cout << "Round trip differs at byte " << same << ".\n";
+            return 1;
+        }
+        std::cout << "Round trip matches all " << image.size()
+                  << " bytes.\n";
+        return 0;
+    }
+
+    if (info.getFlag("--output").has_value()) {
+        std::ofstream output(info.getFlag("--output").value());
+        output << source;
+    } else
+        std::cout << source;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        return disassemble(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
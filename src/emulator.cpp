@@ -0,0 +1,287 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include "CLI.hpp"
+#include "Emulator.hpp"
+#include "Jit.hpp"
+#include "Lockstep.hpp"
+#include "OutputFormat.hpp"
+#include "PortDevices.hpp"
+#include "Profiler.hpp"
+
+// Runs the image on the interpreter and on the JIT side by side, in
+// slices of varying length so blocks are also cut short by the step
+// budget, and compares the architectural state after every slice.
+static bool verifyJit(std::span<const uint8_t> image, uint64_t maxSteps) {
+    Emulator reference(image);
+    JitEmulator jit(image);
+    if (!jit.compiles())
+        std::cout << "JIT is not available here; checking the fallback.\n";
+
+    static const uint64_t slices[] = {1, 3, 7, 64, 1000, 4096, 100000};
+    uint64_t executed = 0;
+    for (size_t i = 0; executed < maxSteps; i++) {
+        uint64_t slice = std::min(slices[i % std::size(slices)],
+                                  maxSteps - executed);
+        StopReason expected = reference.run(slice);
+        StopReason actual = jit.run(slice);
+        const CpuState& a = reference.state();
+        const CpuState& b = jit.state();
+        if (expected != actual || a.registers != b.registers ||
+            a.accumulator != b.accumulator || a.pc != b.pc ||
+            a.outputPorts != b.outputPorts ||
+            a.instructions != b.instructions || a.cycles != b.cycles) {
+            std::cout << "JIT diverged from the interpreter after "
+                      << a.instructions << " instructions.\nInterpreter:\n"
+                      << Emulator::report(a, expected, {}) << "JIT:\n"
+                      << Emulator::report(b, actual, {});
+            return false;
+        }
+        executed = a.instructions;
+        if (expected != StopReason::STEP_LIMIT)
+            break;
+    }
+    std::cout << "JIT matches the interpreter over "
+              << reference.state().instructions << " instructions.\n";
+    return true;
+}
+
+// One instance per non-empty line: up to eight hex bytes, the values of
+// input ports 0 to 7.
+static std::vector<std::array<uint8_t, 8>> readInputs(const std::string& path) {
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("No such file: " + path + "!");
+    std::vector<std::array<uint8_t, 8>> inputs;
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); number++) {
+        std::istringstream words(line);
+        std::array<uint8_t, 8> ports{};
+        std::string word;
+        size_t port = 0;
+        for (; words >> word; port++) {
+            size_t used = 0;
+            unsigned long value = 0;
+            try {
+                value = std::stoul(word, &used, 16);
+            } catch (const std::exception&) {
+            }
+            if (port == ports.size() || used != word.size() || value > 0xFF)
+                throw std::runtime_error(path + ":" + std::to_string(number) +
+                                         ": expected up to 8 hex bytes!");
+            ports[port] = value;
+        }
+        if (port > 0)
+            inputs.push_back(ports);
+    }
+    return inputs;
+}
+
+// Runs every instance on the interpreter too and compares the final
+// states one by one.
+static bool verifyLockstep(std::span<const uint8_t> image,
+                           const std::vector<std::array<uint8_t, 8>>& inputs,
+                           uint64_t maxSteps) {
+    LockstepEmulator lockstep(image, inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++)
+        lockstep.setInputs(i, inputs[i]);
+    lockstep.run(maxSteps);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        Emulator reference(image);
+        reference.state().inputPorts = inputs[i];
+        StopReason expected = reference.run(maxSteps);
+        const CpuState& a = reference.state();
+        CpuState b = lockstep.state(i);
+        if (expected != lockstep.stopReason(i) ||
+            a.registers != b.registers || a.accumulator != b.accumulator ||
+            a.pc != b.pc || a.outputPorts != b.outputPorts ||
+            a.instructions != b.instructions || a.cycles != b.cycles) {
+            std::cout << "Instance " << i
+                      << " diverged from the interpreter.\nInterpreter:\n"
+                      << Emulator::report(a, expected, {}) << "Lockstep:\n"
+                      << Emulator::report(b, lockstep.stopReason(i), {});
+            return false;
+        }
+    }
+    std::cout << "Lockstep matches the interpreter on " << inputs.size()
+              << " instances.\n";
+    return true;
+}
+
+// "PORT:PATH,PORT:PATH...", with "-" for standard input or output.
+static std::vector<std::pair<uint8_t, std::string>> parsePorts(
+    const std::string& list) {
+    std::vector<std::pair<uint8_t, std::string>> ports;
+    std::istringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        size_t colon = item.find(':');
+        if (colon != 1 || item[0] < '0' || item[0] > '7' ||
+            colon + 1 == item.size())
+            throw std::runtime_error("Expected PORT:PATH with a port from 0 "
+                                     "to 7, got \"" + item + "\"!");
+        ports.emplace_back(item[0] - '0', item.substr(colon + 1));
+    }
+    return ports;
+}
+
+// Streams files through the ports given by --in and --out while the
+// program runs.
+static void runWithDevices(std::span<const uint8_t> image,
+                           uint8_t bankPort,
+                           std::optional<std::string> in,
+                           std::optional<std::string> out,
+                           uint64_t maxSteps) {
+    Emulator emulator(image, bankPort);
+    std::vector<std::unique_ptr<std::ifstream>> files;
+    std::vector<std::unique_ptr<std::ofstream>> results;
+    bool toStdout = false;
+    PortDevices devices(emulator);
+    for (const auto& [port, path] : parsePorts(in.value_or(""))) {
+        if (path == "-") {
+            devices.input(port, std::cin);
+            continue;
+        }
+        files.push_back(std::make_unique<std::ifstream>(path,
+                                                        std::ios::binary));
+        if (!*files.back())
+            throw std::runtime_error("No such file: " + path + "!");
+        devices.input(port, *files.back());
+    }
+    for (const auto& [port, path] : parsePorts(out.value_or(""))) {
+        if (path == "-") {
+            toStdout = true;
+            devices.output(port, std::cout);
+            continue;
+        }
+        results.push_back(std::make_unique<std::ofstream>(
+            path, std::ios::binary));
+        if (!*results.back())
+            throw std::runtime_error("Cannot write " + path + "!");
+        devices.output(port, *results.back());
+    }
+    auto start = std::chrono::steady_clock::now();
+    StopReason reason = devices.run(maxSteps);
+    devices.finish();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    (toStdout ? std::cerr : std::cout)
+        << Emulator::report(emulator.state(), reason, elapsed);
+}
+
+static int emulate(int argc, char* argv[]) {
+    InputInfo info(argc, argv,
+                   {"--format", "--max-steps", "--jit", "--verify-jit",
+                    "--profile", "--lockstep", "--verify-lockstep", "--in",
+                    "--out", "--bank-port"});
+    std::ifstream file(info.getInputPath(), std::ios::binary);
+    if (!file)
+        throw std::runtime_error("No such file!");
+    std::string data(std::istreambuf_iterator<char>(file), {});
+
+    OutputFormat format = info.getFlag("--format").has_value()
+                              ? ImageEncoder::parseFormat(
+                                    info.getFlag("--format").value())
+                              : ImageEncoder::detectFormat(data);
+    uint64_t maxSteps = 0;
+    if (info.getFlag("--max-steps").has_value())
+        maxSteps = std::stoull(info.getFlag("--max-steps").value());
+    std::vector<uint8_t> image = ImageEncoder::decode(format, data);
+
+    // Banked images run on the interpreter only.
+    uint8_t bankPort = Emulator::noBankPort;
+    if (std::optional<std::string> port = info.getFlag("--bank-port")) {
+        if (info.getFlag("--jit").has_value() ||
+            info.getFlag("--verify-jit").has_value() ||
+            info.getFlag("--lockstep").has_value() ||
+            info.getFlag("--verify-lockstep").has_value() ||
+            info.getFlag("--profile").has_value())
+            throw std::runtime_error(
+                "--bank-port cannot be combined with --jit, --lockstep or "
+                "--profile!");
+        bankPort = std::stoul(*port);
+        if (bankPort >= 8)
+            throw std::runtime_error("No such port: " + *port + "!");
+    }
+
+    if (info.getFlag("--verify-jit").has_value())
+        return verifyJit(image, maxSteps == 0 ? 10000000 : maxSteps) ? 0 : 1;
+
+    if (std::optional<std::string> path = info.getFlag("--verify-lockstep"))
+        return verifyLockstep(image, readInputs(*path),
+                              maxSteps == 0 ? 10000000 : maxSteps)
+                   ? 0
+                   : 1;
+
+    if (std::optional<std::string> path = info.getFlag("--lockstep")) {
+        std::vector<std::array<uint8_t, 8>> inputs = readInputs(*path);
+        LockstepEmulator lockstep(image, inputs.size());
+        for (size_t i = 0; i < inputs.size(); i++)
+            lockstep.setInputs(i, inputs[i]);
+        std::string summary = lockstep.runAndReport(maxSteps);
+        for (size_t i = 0; i < inputs.size(); i++) {
+            CpuState cpu = lockstep.state(i);
+            std::cout << "#" << i << " " << stopReasonNames[int(
+                                                 lockstep.stopReason(i))]
+                      << ", " << cpu.instructions << " instructions, OUT:";
+            for (uint8_t value : cpu.outputPorts)
+                std::cout << " " << std::hex << std::setw(2)
+                          << std::setfill('0') << int(value) << std::dec;
+            std::cout << "\n";
+        }
+        std::cout << summary;
+        return 0;
+    }
+
+    // Without the source, addresses are named by their disassembly only.
+    if (std::optional<std::string> path = info.getFlag("--profile")) {
+        if (info.getFlag("--jit").has_value())
+            throw std::runtime_error("--profile runs on the interpreter only!");
+        Emulator emulator(image);
+        ExecutionProfile profile;
+        auto start = std::chrono::steady_clock::now();
+        StopReason reason = emulator.profile(profile, maxSteps);
+        std::cout << Emulator::report(emulator.state(), reason,
+                                      std::chrono::steady_clock::now() -
+                                          start);
+        ProfileReport report(emulator, profile);
+        std::cout << report.text();
+        if (!path->empty()) {
+            std::ofstream folded(*path);
+            folded << report.folded();
+            if (!folded)
+                throw std::runtime_error("Cannot write " + *path + "!");
+        }
+        return 0;
+    }
+
+    if (info.getFlag("--in").has_value() || info.getFlag("--out").has_value()) {
+        if (info.getFlag("--jit").has_value())
+            throw std::runtime_error("--in and --out run on the interpreter "
+                                     "only!");
+        runWithDevices(image, bankPort, info.getFlag("--in"),
+                       info.getFlag("--out"), maxSteps);
+        return 0;
+    }
+
+    if (info.getFlag("--jit").has_value()) {
+        JitEmulator emulator(image);
+        std::cout << emulator.runAndReport(maxSteps);
+        return 0;
+    }
+    Emulator emulator(image, bankPort);
+    std::cout << emulator.runAndReport(maxSteps);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        return emulate(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
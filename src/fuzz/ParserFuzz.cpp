@@ -0,0 +1,65 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include "Assembler.hpp"
+#include "Disassembler.hpp"
+#include "Incremental.hpp"
+#include "Lexer.hpp"
+#include "SourceFile.hpp"
+
+// Feeds arbitrary bytes to the front end: the lexer and operand parser
+// token by token, then the whole assembler. Errors are expected, crashes
+// are not. The same input is also assembled incrementally, as a first
+// half followed by the rest, and must give the same image or fail the
+// same way as a full assembly. Finally the bytes are disassembled as an
+// image, and the listing must assemble.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string_view source(reinterpret_cast<const char*>(data), size);
+
+    TokenList tokens;
+    forEachLine(source, [&](std::string_view line, size_t lineNumber) {
+        Lexer::tokenize(line, lineNumber, tokens);
+        Operand operand;
+        for (size_t i = 0; i < tokens.size() && i < 8; i++)
+            Operand::parse(tokens[i].text, operand);
+    });
+
+    static Assembler assembler("fuzz");
+    std::vector<uint8_t> image;
+    bool assembled = true;
+    try {
+        std::span<const uint8_t> code = assembler.assemble(source);
+        image.assign(code.begin(), code.end());
+    } catch (const std::runtime_error&) {
+        assembled = false;
+    }
+
+    IncrementalAssembler incremental("fuzz");
+    try {
+        incremental.load(std::string(source.substr(0, size / 2)));
+    } catch (const std::runtime_error&) {
+    }
+    bool updated = true;
+    try {
+        incremental.update(std::string(source));
+    } catch (const std::runtime_error&) {
+        updated = false;
+    }
+    if (assembled != updated || (assembled && incremental.getImage() != image)) {
+        std::cerr << "Incremental assembly disagrees with a full one.\n";
+        std::abort();
+    }
+
+    static const Disassembler disassembler;
+    std::string listing = disassembler.disassemble({data, size});
+    try {
+        assembler.assemble(listing);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Listing does not assemble:\n" << listing << e.what();
+        std::abort();
+    }
+    return 0;
+}
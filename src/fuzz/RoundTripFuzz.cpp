@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Assembler.hpp"
+#include "Disassembler.hpp"
+
+// Turns the fuzzer's bytes into a valid program, assembles it in memory,
+// disassembles the image and assembles that listing again: both images
+// must match byte for byte, and the second listing must match the first.
+// Every assemblable form is reachable: the forms come from the encoders
+// bound in builtinCommands, like the benchmarks' SourceGenerator.
+namespace {
+
+struct Form {
+    std::string_view mnemonic;
+    OperandType first;
+    OperandType second;
+};
+
+const std::vector<Form>& forms() {
+    static const std::vector<Form> result = [] {
+        std::vector<Form> forms;
+        for (const CommandDescriptor* desc : builtinCommands)
+            for (size_t i = 0; i < desc->encoders.size(); i++)
+                if (desc->encoders[i] != nullptr)
+                    forms.push_back({desc->name, operandTypeOfKind(i / 4),
+                                     operandTypeOfKind(i % 4)});
+        return forms;
+    }();
+    return result;
+}
+
+// Reads choices off the input, then zeros once it runs out.
+class Choices {
+    const uint8_t* data;
+    size_t size;
+
+  public:
+    Choices(const uint8_t* data, size_t size) : data(data), size(size) {}
+    bool empty() const { return size == 0; }
+    uint8_t next() {
+        if (size == 0)
+            return 0;
+        size--;
+        return *data++;
+    }
+};
+
+constexpr size_t labelCount = 4;
+
+std::string operand(OperandType type, Choices& choices) {
+    static const char* digits = "0123456789ABCDEF";
+    uint8_t value = choices.next();
+    switch (type) {
+        case ACCUMULATOR:
+            return "A";
+        case REGISTER:
+            return std::string("R") + digits[value % 8];
+        default:
+            // Now and then a label instead of a number.
+            if (value >= 0xF0)
+                return "label" + std::to_string(value % labelCount);
+            return {digits[value >> 4], digits[value & 0xF]};
+    }
+}
+
+std::string generate(Choices& choices) {
+    std::string source;
+    bool defined[labelCount] = {};
+    while (!choices.empty()) {
+        uint8_t shape = choices.next();
+        if (shape % 16 == 0) {
+            source += "// comment\n";
+            continue;
+        }
+        if (shape % 16 == 1 && !defined[shape / 16 % labelCount]) {
+            defined[shape / 16 % labelCount] = true;
+            source += "label" + std::to_string(shape / 16 % labelCount) + ": ";
+        }
+        const Form& form = forms()[choices.next() % forms().size()];
+        source += form.mnemonic;
+        if (form.first != NONE)
+            source += " " + operand(form.first, choices);
+        if (form.second != NONE)
+            source += ", " + operand(form.second, choices);
+        source += '\n';
+    }
+    // Labels the body never defined go first, at address 0.
+    for (size_t i = 0; i < labelCount; i++)
+        if (!defined[i])
+            source = "label" + std::to_string(i) + ":\n" + source;
+    return source;
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static Assembler assembler("fuzz");
+    static const Disassembler disassembler;
+
+    // No line makes more code than 1.5 times the input it consumes, so
+    // this keeps every label address within a byte.
+    Choices choices(data, std::min<size_t>(size, 160));
+    std::string source = generate(choices);
+    std::vector<uint8_t> image;
+    try {
+        std::span<const uint8_t> code = assembler.assemble(source);
+        image.assign(code.begin(), code.end());
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Generated program does not assemble:\n"
+                  << source << e.what() << "\n";
+        std::abort();
+    }
+
+    std::string listing = disassembler.disassemble(image);
+    std::span<const uint8_t> again = assembler.assemble(listing);
+    if (!std::equal(image.begin(), image.end(), again.begin(), again.end())) {
+        std::cerr << "Round trip changed the image:\n"
+                  << source << "Listing:\n"
+                  << listing;
+        std::abort();
+    }
+    if (disassembler.disassemble(again) != listing) {
+        std::cerr << "Listing is not stable:\n" << listing;
+        std::abort();
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+// Stands in for libFuzzer's driver where the compiler has none (GCC):
+// replays the files given on the command line, which also suits AFL++'s
+// "@@" mode, or without files runs the target on random inputs.
+//
+//     asmz_fuzz_roundtrip [--runs=N] [--seed=N] [file...]
+int main(int argc, char* argv[]) {
+    size_t runs = 1000000;
+    unsigned seed = 1;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument.starts_with("--runs="))
+            runs = std::stoull(argument.substr(7));
+        else if (argument.starts_with("--seed="))
+            seed = std::stoul(argument.substr(7));
+        else
+            files.push_back(argument);
+    }
+
+    for (const std::string& path : files) {
+        std::ifstream file(path, std::ios::binary);
+        std::string data(std::istreambuf_iterator<char>(file), {});
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(data.data()),
+                               data.size());
+    }
+    if (!files.empty())
+        return 0;
+
+    std::mt19937 random(seed);
+    std::vector<uint8_t> input;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t run = 0; run < runs; run++) {
+        input.resize(random() % 257);
+        for (uint8_t& byte : input)
+            byte = random();
+        // Mostly printable text, so the parser gets past the lexer.
+        if (run % 2 == 0)
+            for (uint8_t& byte : input)
+                byte = "ADMNOPRSUVZJFLIHTC0123456789ab:, \n/"[byte % 35];
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << runs << " runs in " << elapsed.count() << " s ("
+              << size_t(runs / elapsed.count()) << " exec/s)\n";
+}
@@ -0,0 +1,74 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include "BankPacker.hpp"
+#include "CLI.hpp"
+#include "Linker.hpp"
+#include "ObjectFile.hpp"
+#include "OutputFormat.hpp"
+
+// Links the objects written by AsmZCompiler --object into one image, in
+// the order they are given. --output, --format and --binary-size mean the
+// same as for AsmZCompiler. --bank-port=P packs them into 256-byte banks
+// switched through output port P instead (see BankPacker).
+static int link(int argc, char* argv[]) {
+    InputInfo info(argc, argv,
+                   {"--output", "--format", "--binary-size", "--bank-port"});
+    std::optional<std::string> bankPort = info.getFlag("--bank-port");
+    if (bankPort.has_value() && std::stoul(*bankPort) >= 8)
+        throw std::runtime_error("No such port: " + *bankPort + "!");
+    Linker linker;
+    BankPacker packer(bankPort.has_value() ? std::stoul(*bankPort) : 0);
+    for (const std::string& path : info.getInputPaths()) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("No such file: " + path + "!");
+        std::string data(std::istreambuf_iterator<char>(file), {});
+        if (bankPort.has_value())
+            packer.add(path, ObjectFile::parse(data, path));
+        else
+            linker.add(path, ObjectFile::parse(data, path));
+    }
+
+    size_t targetSize = 0;
+    if (info.getFlag("--binary-size").has_value())
+        targetSize = std::stoull(info.getFlag("--binary-size").value());
+    OutputFormat format = OutputFormat::HEX_TEXT;
+    if (info.getFlag("--format").has_value())
+        format = ImageEncoder::parseFormat(info.getFlag("--format").value());
+    std::vector<uint8_t> image;
+    if (bankPort.has_value()) {
+        image = packer.pack();
+        if (targetSize > 0 && image.size() > targetSize)
+            throw std::runtime_error(
+                "Source code is too big to be compiled to file of size: " +
+                std::to_string(targetSize));
+        image.resize(std::max(image.size(), targetSize), 0);
+        std::cout << packer.report();
+    } else
+        image = linker.link(targetSize);
+
+    std::filesystem::path outputPath =
+        info.getFlag("--output").has_value()
+            ? std::filesystem::path(info.getFlag("--output").value())
+            : std::filesystem::path(info.getInputPath())
+                  .parent_path()
+                  .append("output.bin");
+    std::ofstream output(outputPath, std::ios::binary);
+    std::string encoded = ImageEncoder::encode(format, image);
+    output.write(encoded.data(), encoded.size());
+    if (!output)
+        throw std::runtime_error("Cannot write " + outputPath.string() + "!");
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        return link(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
@@ -5,24 +5,145 @@
 #include <optional>
 #include <ranges>
 #include <vector>
+#include "Batch.hpp"
+#include "BuildCache.hpp"
 #include "CLI.hpp"
 #include "Commands.hpp"
+#include "Emulator.hpp"
+#include "Profiler.hpp"
 #include "Translator.hpp"
 #include "Types.hpp"
+#include "Watch.hpp"
 namespace fs = std::filesystem;
 
 #include <chrono>
 using namespace std::chrono;
 
-int main(int argc, char* argv[]) {
-    CompilerConfig::acceptableFlags = {"--output", "--binary-size"};
-    CompilerConfig::commands.impl = {&cNOP, &cLDA, &cMV1,  &cMV2, &cADD,
-                                     &cSUB, &cINC, &cDEC,  &cJMP, &cJFZ,
-                                     &cIN,  &cOUT, &cPUSH, &cPOP, &cHLT};
+static int compile(int argc, char* argv[]) {
+    InputInfo info(argc, argv,
+                   {"--output", "--binary-size", "--format", "--run",
+                    "--jobs", "--cache", "--optimize", "--stats", "--watch",
+                    "--profile", "--object"});
+    TranslatorOptions options = TranslatorOptions::fromFlags(info);
+    // An object has no final addresses yet, so nothing can pad, encode or
+    // run it before AsmZLinker does.
+    if (options.object &&
+        (options.targetSize > 0 || info.getFlag("--format").has_value() ||
+         info.getFlag("--run").has_value() ||
+         info.getFlag("--profile").has_value() ||
+         info.getFlag("--watch").has_value()))
+        throw std::runtime_error(
+            "--object cannot be combined with --binary-size, --format, "
+            "--run, --profile or --watch!");
+
+    std::optional<BuildCache> cache;
+    if (info.getFlag("--cache").has_value())
+        cache.emplace(info.getFlag("--cache").value());
+    auto reportCache = [&] {
+        if (cache.has_value())
+            std::cout << "Cache: " << cache->getHits() << " hits, "
+                      << cache->getMisses() << " misses.\n";
+    };
+
+    // --stats prints a text table; --stats=json prints one JSON object.
+    std::optional<std::string> statsFormat = info.getFlag("--stats");
+    if (statsFormat.has_value() && !statsFormat->empty() &&
+        statsFormat != "json")
+        throw std::runtime_error("Unknown stats format: " + *statsFormat +
+                                 "!");
+    // --profile runs the program and prints where it spent its cycles;
+    // --profile=FILE also writes them to FILE as folded stacks.
+    std::optional<std::string> profilePath = info.getFlag("--profile");
+
+    std::vector<fs::path> sources =
+        BatchAssembler::collectSources(info.getInputPaths());
+    // A glob or directory that matches nothing is a mistake, not an empty
+    // batch.
+    if (sources.empty())
+        throw std::runtime_error("No input files to assemble!");
+    if (sources.size() != 1 || info.getFlag("--jobs").has_value()) {
+        if (statsFormat.has_value())
+            throw std::runtime_error("--stats needs a single input file!");
+        if (info.getFlag("--watch").has_value())
+            throw std::runtime_error("--watch needs a single input file!");
+        if (profilePath.has_value())
+            throw std::runtime_error("--profile needs a single input file!");
+        if (info.getFlag("--run").has_value())
+            throw std::runtime_error("--run needs a single input file!");
+        size_t jobs = std::thread::hardware_concurrency();
+        if (info.getFlag("--jobs").has_value())
+            jobs = std::stoul(info.getFlag("--jobs").value());
+        BatchAssembler batch(sources, options, jobs,
+                             cache.has_value() ? &*cache : nullptr);
+        size_t failed = batch.run(std::cerr);
+        std::cout << "Assembled " << sources.size() - failed << " of "
+                  << sources.size() << " files.\n";
+        reportCache();
+        return failed == 0 ? 0 : 1;
+    }
 
-    InputInfo info(argc, argv);
-    Translator tr(info);
-    tr.run();
+    std::string input = sources.front().string();
+    // Incremental reassembly works line by line, which the optimizer does
+    // not.
+    if (info.getFlag("--watch").has_value()) {
+        if (options.optimize || statsFormat.has_value() ||
+            cache.has_value() || info.getFlag("--run").has_value() ||
+            profilePath.has_value())
+            throw std::runtime_error(
+                "--watch cannot be combined with --optimize, --stats, "
+                "--cache, --run or --profile!");
+        IncrementalAssembler::rejectDirectives(SourceFile(input).text(),
+                                               input);
+        SourceWatcher(input, options).run(std::cout, std::cerr);
+    }
+    std::vector<uint8_t> image;
+    LineTable lineTable(input);
+    // Statistics describe a real assembly and profiles need its line
+    // table, so both bypass the cache.
+    if (cache.has_value() && !statsFormat.has_value() &&
+        !profilePath.has_value()) {
+        cache->assemble(input, options);
+        reportCache();
+        if (info.getFlag("--run").has_value()) {
+            std::ifstream file(options.resolveOutputPath(input),
+                               std::ios::binary);
+            std::string data(std::istreambuf_iterator<char>(file), {});
+            image = ImageEncoder::decode(options.format, data);
+        }
+    } else {
+        AssemblyStats stats;
+        Translator tr(input, options);
+        if (profilePath.has_value())
+            tr.recordLines(lineTable);
+        tr.run(statsFormat.has_value() ? &stats : nullptr);
+        image = tr.getImage();
+        if (tr.getOptimizer().has_value() && statsFormat != "json")
+            std::cout << tr.getOptimizer()->report();
+        if (statsFormat.has_value())
+            std::cout << (*statsFormat == "json" ? stats.json()
+                                                 : stats.report());
+    }
+
+    if (profilePath.has_value()) {
+        Emulator emulator(image);
+        ExecutionProfile profile;
+        auto start = steady_clock::now();
+        StopReason reason = emulator.profile(profile);
+        std::cout << Emulator::report(emulator.state(), reason,
+                                      steady_clock::now() - start);
+        ProfileReport report(emulator, profile, &lineTable);
+        std::cout << report.text();
+        if (!profilePath->empty()) {
+            std::ofstream folded(*profilePath);
+            folded << report.folded();
+            if (!folded)
+                throw std::runtime_error("Cannot write " + *profilePath +
+                                         "!");
+        }
+    } else if (info.getFlag("--run").has_value()) {
+        Emulator emulator(image);
+        std::cout << emulator.runAndReport();
+    }
 
     //    if (argc > 3) {
     //        std::cout << "Too many arguments!\n";
@@ -54,4 +175,15 @@ int main(int argc, char* argv[]) {
     //        if (expr.has_value())
     //            compileStatement(expr.value(), outputFile);
     //    }
+    return 0;
+}
+
+// Assembly errors arrive as one exception listing all of them.
+int main(int argc, char* argv[]) {
+    try {
+        return compile(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
 }
@@ -0,0 +1,14 @@
+# Assembles SOURCE with COMPILER into OUTPUT and fails unless the result is
+# byte for byte the same as EXPECTED. Run with cmake -P.
+execute_process(
+    COMMAND ${COMPILER} ${SOURCE} --output=${OUTPUT}
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${SOURCE} does not assemble")
+endif()
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED}
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${OUTPUT} differs from ${EXPECTED}")
+endif()
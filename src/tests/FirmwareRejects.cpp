@@ -0,0 +1,17 @@
+#include "Firmware.hpp"
+#include "FirmwareSources.hpp"
+
+// Each case must fail to compile, the way Assembler rejects its source;
+// the build defines one of them.
+#if defined(ASMZ_REJECT_LABEL_PAST_END)
+constexpr LabelAtEnd<253> pastEnd;
+constexpr Firmware firmware = assembleFirmware(pastEnd.source());
+#elif defined(ASMZ_REJECT_ADD_ACCUMULATOR_LITERAL)
+constexpr Firmware firmware = assembleFirmware("ADD A, 05\nHLT\n");
+#elif defined(ASMZ_REJECT_UNBOUND_ENCODER)
+constexpr std::array<Operand, 2> operands{Operand("A"), Operand("05")};
+constexpr const CommandDescriptor& add = cADD;
+constexpr Encoding encoding = add.encode(operands);
+#endif
+
+int main() {}
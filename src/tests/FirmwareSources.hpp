@@ -0,0 +1,33 @@
+#ifndef FIRMWARESOURCES_HPP
+#define FIRMWARESOURCES_HPP
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+// "MV R1, end", nops NOPs and the label "end:" after them: end lands at
+// address 3 + nops, so 252 NOPs put it on the last byte and 253 one past the
+// 256-byte space.
+template <size_t nops>
+struct LabelAtEnd {
+    static constexpr std::string_view head = "MV R1, end\n";
+    static constexpr std::string_view tail = "end:\n";
+    std::array<char, head.size() + 4 * nops + tail.size()> text{};
+
+    constexpr LabelAtEnd() {
+        size_t at = 0;
+        for (char c : head)
+            text[at++] = c;
+        for (size_t i = 0; i < nops; i++)
+            for (char c : std::string_view("NOP\n"))
+                text[at++] = c;
+        for (char c : tail)
+            text[at++] = c;
+    }
+
+    constexpr std::string_view source() const {
+        return {text.data(), text.size()};
+    }
+};
+
+#endif  // FIRMWARESOURCES_HPP
@@ -0,0 +1,54 @@
+#include <algorithm>
+#include <iostream>
+#include "Assembler.hpp"
+#include "Firmware.hpp"
+#include "FirmwareSources.hpp"
+
+// assembleFirmware runs while this file compiles; main then checks that
+// the Assembler produces the same bytes for the same sources.
+
+// examples/labels: done is used before its definition, loop after.
+constexpr std::string_view labels = R"(MV R3, 05
+MV R4, 00
+MV R1, done
+MV R2, loop
+loop:
+    MV R3
+    JFZ A, R1
+    ADD R4, 02
+    SUB R3, 01
+    JMP R2
+done: HLT
+)";
+
+constexpr Firmware labelsFirmware = assembleFirmware(labels);
+constexpr std::array<uint8_t, 25> labelsImage = {
+    0x12, 0xc3, 0x05, 0x12, 0xc4, 0x00, 0x12, 0xc1, 0x18,
+    0x12, 0xc2, 0x0c, 0x12, 0x43, 0x08, 0x01, 0x13, 0xc4,
+    0x02, 0x14, 0xc3, 0x01, 0x07, 0xc2, 0xff};
+static_assert(labelsFirmware.size == labelsImage.size());
+static_assert(std::equal(labelsImage.begin(), labelsImage.end(),
+                         labelsFirmware.bytes.begin()));
+
+// The last address a label can take.
+constexpr LabelAtEnd<252> lastByte;
+constexpr Firmware lastByteFirmware = assembleFirmware(lastByte.source());
+static_assert(lastByteFirmware.size == 255);
+static_assert(lastByteFirmware.bytes[2] == 0xFF);
+
+static bool matchesAssembler(std::string_view name,
+                             std::string_view source,
+                             const Firmware& firmware) {
+    Assembler assembler;
+    std::span<const uint8_t> code = assembler.assemble(source);
+    if (std::ranges::equal(code, firmware.image()))
+        return true;
+    std::cout << name << ": assembleFirmware differs from Assembler.\n";
+    return false;
+}
+
+int main() {
+    bool ok = matchesAssembler("labels", labels, labelsFirmware);
+    ok &= matchesAssembler("last byte", lastByte.source(), lastByteFirmware);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "Assembler.hpp"
+#include "Incremental.hpp"
+
+// Applies a fixed series of random line edits to a program and checks
+// after every one that IncrementalAssembler gives the image Assembler
+// gives for the whole source, or fails when it fails, and that bytes
+// outside the update's range did not change.
+
+static std::string hex(uint32_t value) {
+    const char* digits = "0123456789ABCDEF";
+    return {digits[value >> 4 & 0xF], digits[value & 0xF]};
+}
+
+// A line of the kind a program is made of. Labels come from a small set,
+// so edits define, use, duplicate and drop them.
+static std::string randomLine(std::mt19937& random) {
+    std::string r = "R" + std::to_string(random() % 8);
+    std::string s = "R" + std::to_string(random() % 8);
+    std::string label = "l" + std::to_string(random() % 6);
+    switch (random() % 16) {
+        case 0: return "NOP";
+        case 1: return random() % 2 ? "INC" : "DEC";
+        case 2: return "HLT";
+        case 3: return "LDA " + hex(random());
+        case 4: return "MV " + r + ", " + hex(random());
+        case 5: return "MV " + r + ", " + s;
+        case 6: return random() % 2 ? "MV " + r + ", A" : "MV " + r;
+        case 7: return "ADD " + r + ", " + hex(random());
+        case 8: return "SUB " + r + ", " + s;
+        case 9: return "ADD A, " + r;
+        case 10: return "JMP " + r;
+        case 11: return "JFZ A, " + r;
+        case 12: return label + ":";
+        case 13: return label + ": INC";
+        case 14: return "    MV " + r + ", " + label + " // to " + label;
+        default: return random() % 2 ? "" : "// comment";
+    }
+}
+
+static std::string join(const std::vector<std::string>& lines) {
+    std::string source;
+    for (const std::string& line : lines)
+        source += line + "\n";
+    return source;
+}
+
+int main() {
+    std::mt19937 random(7);
+    // examples/labels
+    std::vector<std::string> lines = {"MV R3, 05",
+                                      "MV R4, 00",
+                                      "MV R1, l0",
+                                      "MV R2, l1",
+                                      "l1:",
+                                      "    MV R3",
+                                      "    JFZ A, R1",
+                                      "    ADD R4, 02",
+                                      "    SUB R3, 01",
+                                      "    JMP R2",
+                                      "l0: HLT"};
+    IncrementalAssembler incremental;
+    incremental.load(join(lines));
+
+    size_t patched = 0, relaidOut = 0, failed = 0;
+    for (size_t edit = 0; edit < 3000; edit++) {
+        std::vector<std::string> edited = lines;
+        size_t at = random() % edited.size();
+        switch (random() % 4) {
+            case 0:
+                edited[at] = randomLine(random);
+                break;
+            case 1:
+                if (edited.size() < 60)
+                    edited.insert(edited.begin() + at, randomLine(random));
+                break;
+            case 2:
+                if (edited.size() > 1)
+                    edited.erase(edited.begin() + at);
+                break;
+            default:
+                // Same size and labels: a literal changes in place.
+                if (size_t comma = edited[at].find(", ");
+                    comma != std::string::npos &&
+                    edited[at].find("MV R") != std::string::npos &&
+                    edited[at].size() == comma + 4 &&
+                    edited[at][comma + 2] != 'R')
+                    edited[at].replace(comma + 2, 2, hex(random()));
+                break;
+        }
+        std::string source = join(edited);
+
+        std::vector<uint8_t> expected;
+        bool valid = true;
+        try {
+            Assembler assembler;
+            std::span<const uint8_t> code = assembler.assemble(source);
+            expected.assign(code.begin(), code.end());
+        } catch (const std::runtime_error&) {
+            valid = false;
+        }
+
+        std::vector<uint8_t> before = incremental.getImage();
+        IncrementalAssembler::Update update;
+        try {
+            update = incremental.update(source);
+        } catch (const std::runtime_error& e) {
+            if (valid) {
+                std::cout << "Edit " << edit << " fails incrementally only:\n"
+                          << e.what() << "\n" << source;
+                return 1;
+            }
+            failed++;
+            continue;  // both keep the previous program
+        }
+        if (!valid) {
+            std::cout << "Edit " << edit << " fails in full only:\n"
+                      << source;
+            return 1;
+        }
+        const std::vector<uint8_t>& image = incremental.getImage();
+        if (image != expected) {
+            std::cout << "Edit " << edit << " assembles differently:\n"
+                      << source;
+            return 1;
+        }
+        // A new size rewrites the whole output, so the range only covers
+        // the bytes both images have.
+        if (image.size() != before.size() && !update.relaidOut) {
+            std::cout << "Edit " << edit << " resized a patched image:\n"
+                      << source;
+            return 1;
+        }
+        for (size_t i = 0; i < std::min(before.size(), image.size()); i++)
+            if ((i < update.firstByte || i >= update.endByte) &&
+                before[i] != image[i]) {
+                std::cout << "Edit " << edit << " changed byte " << i
+                          << " outside its update:\n" << source;
+                return 1;
+            }
+        if (update.firstLine != 0)
+            (update.relaidOut ? relaidOut : patched)++;
+        lines = std::move(edited);
+    }
+
+    std::cout << patched << " edits patched, " << relaidOut
+              << " laid out again, " << failed << " rejected.\n";
+    // The series must take each path.
+    return patched > 0 && relaidOut > 0 && failed > 0 ? 0 : 1;
+}
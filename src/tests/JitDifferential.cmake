@@ -0,0 +1,22 @@
+# Generates COUNT random images with GENERATOR from SEED into DIRECTORY
+# and fails unless EMULATOR --verify-jit accepts every one of them. Run
+# with cmake -P.
+file(REMOVE_RECURSE ${DIRECTORY})
+execute_process(
+    COMMAND ${GENERATOR} ${DIRECTORY} ${COUNT} ${SEED}
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "the random images do not cover the JIT")
+endif()
+math(EXPR last "${COUNT} - 1")
+foreach(n RANGE ${last})
+    set(image ${DIRECTORY}/image_${n}.bin)
+    execute_process(
+        COMMAND ${EMULATOR} ${image} --format=bin --verify-jit
+            --max-steps=20000
+        RESULT_VARIABLE result
+        OUTPUT_VARIABLE output)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${image}: ${output}")
+    endif()
+endforeach()
@@ -0,0 +1,45 @@
+# Assembles every module in MODULES (comma separated, from DIRECTORY) with
+# COMPILER --object into WORK and links the objects in that order with
+# LINKER and LINK_FLAGS into WORK/image.hex. Fails unless the image is byte
+# for byte the same as EXPECTED, if given. With EMULATOR, then runs it with
+# RUN_FLAGS. The linker's errors and the emulator's report go to the test's
+# output, for the test to match. Run with cmake -P.
+file(REMOVE_RECURSE ${WORK})
+file(MAKE_DIRECTORY ${WORK})
+string(REPLACE "," ";" MODULES "${MODULES}")
+string(REPLACE "," ";" LINK_FLAGS "${LINK_FLAGS}")
+string(REPLACE "," ";" RUN_FLAGS "${RUN_FLAGS}")
+set(objects)
+foreach(module ${MODULES})
+    execute_process(
+        COMMAND ${COMPILER} ${DIRECTORY}/${module}.z --object
+            --output=${WORK}/${module}.zo
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${module}.z does not assemble")
+    endif()
+    list(APPEND objects ${WORK}/${module}.zo)
+endforeach()
+execute_process(
+    COMMAND ${LINKER} ${objects} ${LINK_FLAGS} --output=${WORK}/image.hex
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "the objects do not link")
+endif()
+if(DEFINED EXPECTED)
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK}/image.hex
+            ${EXPECTED}
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${WORK}/image.hex differs from ${EXPECTED}")
+    endif()
+endif()
+if(DEFINED EMULATOR)
+    execute_process(
+        COMMAND ${EMULATOR} ${WORK}/image.hex ${RUN_FLAGS}
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "the image does not run")
+    endif()
+endif()
@@ -0,0 +1,43 @@
+# Assembles tests/cat.z with COMPILER and streams a file of LINES numbered
+# lines through it on EMULATOR, from input port 0 to output port 1. Fails unless
+# the output is the same file and the run stops blocked on port 0 once the
+# input runs out. Run with cmake -P.
+file(MAKE_DIRECTORY ${WORK})
+execute_process(
+    COMMAND ${COMPILER} ${CMAKE_CURRENT_LIST_DIR}/cat.z
+        --output=${WORK}/cat.hex
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "cat.z does not assemble")
+endif()
+
+# Every line differs, so a lost, repeated or reordered chunk shows.
+set(text)
+foreach(line RANGE 1 ${LINES})
+    string(APPEND text "${line}\n")
+endforeach()
+file(WRITE ${WORK}/input.txt "${text}")
+file(SIZE ${WORK}/input.txt size)
+if(size LESS_EQUAL 4096)
+    message(FATAL_ERROR "the input must be larger than a port ring")
+endif()
+
+execute_process(
+    COMMAND ${EMULATOR} ${WORK}/cat.hex --in=0:${WORK}/input.txt
+        --out=1:${WORK}/output.txt
+    RESULT_VARIABLE result
+    OUTPUT_VARIABLE report)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "cat does not run:\n${report}")
+endif()
+if(NOT report MATCHES "Stopped: port blocked at PC 03")
+    message(FATAL_ERROR "cat did not stop on IN at the end of input:\n"
+        "${report}")
+endif()
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK}/input.txt
+        ${WORK}/output.txt
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "cat changed what it copied")
+endif()
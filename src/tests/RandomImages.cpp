@@ -0,0 +1,126 @@
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "Emulator.hpp"
+
+// Writes count random programs of 256 bytes to directory as
+// image_<n>.bin, for the JIT differential test to run --verify-jit on.
+// The same seed always gives the same images. Fails unless the
+// interpreter executes every micro-operation in at least one of them, so
+// no JIT template goes unchecked. Illegal instructions only stop a run and
+// are not counted.
+// Usage: asmz_random_images <directory> <count> <seed>
+
+constexpr std::array<uint8_t, 12> opcodes = {
+    uint8_t(cNOP.code), uint8_t(cLDA.code), uint8_t(cMV2.code),
+    uint8_t(cADD.code), uint8_t(cSUB.code), uint8_t(cINC.code),
+    uint8_t(cDEC.code), uint8_t(cJMP.code), uint8_t(cJFZ.code),
+    uint8_t(cIN.code),  uint8_t(cOUT.code), uint8_t(cHLT.code)};
+
+// Appends a random valid encoding of opcode: the operand byte takes one of
+// the addressing modes decodeInstruction accepts for it, with y = 0 where
+// that mode requires it.
+static void appendInstruction(std::vector<uint8_t>& image,
+                              uint8_t opcode,
+                              std::mt19937& random) {
+    image.push_back(opcode);
+    uint8_t x = random() % 8;
+    uint8_t y = random() % 8;
+    uint8_t choice = random() % 4;
+    switch (opcode) {
+        case uint8_t(cNOP.code):
+        case uint8_t(cINC.code):
+        case uint8_t(cDEC.code):
+        case uint8_t(cHLT.code):
+            break;
+        case uint8_t(cLDA.code):
+            image.push_back(uint8_t(random()));
+            break;
+        case uint8_t(cIN.code):
+        case uint8_t(cOUT.code):
+            image.push_back(y << 3 | x);
+            break;
+        case uint8_t(cJMP.code):
+            image.push_back(choice == 0 ? 0 : 0b11000000 | x);
+            break;
+        case uint8_t(cJFZ.code):
+            image.push_back(choice == 0 ? x : 0b11000000 | y << 3 | x);
+            break;
+        default:  // MV, ADD and SUB
+            if (choice == 0 && opcode == uint8_t(cMV2.code))
+                image.push_back(0b01000000 | x);  // MV Rx: Acc = Rx
+            else if (choice <= 1)
+                image.push_back(x);
+            else if (choice == 2)
+                image.push_back(0b10000000 | y << 3 | x);
+            else
+                image.insert(image.end(),
+                             {uint8_t(0b11000000 | x), uint8_t(random())});
+            break;
+    }
+}
+
+// HLT is rarer than the rest so that programs run for a while. The image
+// starts by loading every register with the address of a random
+// instruction, so jumps mostly land on one; arithmetic soon moves them
+// into the middle of instructions, so illegal instructions are still met.
+static std::vector<uint8_t> randomImage(std::mt19937& random) {
+    std::vector<uint8_t> image;
+    for (uint8_t x = 0; x < 8; x++)
+        image.insert(image.end(), {uint8_t(cMV2.code), uint8_t(0b11000000 | x),
+                                   0});
+    std::vector<uint8_t> starts;
+    while (image.size() < 256) {
+        starts.push_back(image.size());
+        uint8_t opcode = opcodes[random() % opcodes.size()];
+        if (opcode == uint8_t(cHLT.code) && random() % 4 != 0)
+            opcode = uint8_t(cNOP.code);
+        appendInstruction(image, opcode, random);
+    }
+    image.resize(256);
+    for (uint8_t x = 0; x < 8; x++)
+        image[x * 3 + 2] = starts[random() % starts.size()];
+    return image;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 4) {
+        std::cerr << "Usage: asmz_random_images <directory> <count> <seed>\n";
+        return 1;
+    }
+    std::filesystem::path directory = argv[1];
+    size_t count = std::stoul(argv[2]);
+    std::mt19937 random(std::stoul(argv[3]));
+    std::filesystem::create_directories(directory);
+
+    std::bitset<MICRO_OP_COUNT> executed;
+    for (size_t n = 0; n < count; n++) {
+        std::vector<uint8_t> image = randomImage(random);
+        std::ofstream(directory / ("image_" + std::to_string(n) + ".bin"),
+                      std::ios::binary)
+            .write(reinterpret_cast<const char*>(image.data()), image.size());
+
+        Emulator emulator(image);
+        ExecutionProfile profile;
+        emulator.profile(profile, 10000);
+        for (size_t pc = 0; pc < 256; pc++)
+            if (profile.executions[pc] > 0)
+                executed.set(
+                    decodeInstruction(emulator.state().memory, pc).op);
+    }
+
+    bool ok = true;
+    for (size_t op = 0; op < OP_ILLEGAL; op++)
+        if (!executed[op]) {
+            std::cerr << "No image executes micro-operation " << op << " ("
+                      << microOpMnemonics[op] << ").\n";
+            ok = false;
+        }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Assembler.hpp"
+#include "Emulator.hpp"
+
+// Runs a program with the journal on, steps back as far as the journal
+// reaches and compares every state on the way with a snapshot taken while
+// a second emulator went forward one instruction at a time.
+
+struct Step {
+    CpuSnapshot snapshot;
+    std::array<uint8_t, 256> memory;
+};
+
+static bool same(const CpuSnapshot& a, const CpuSnapshot& b) {
+    return a.registers == b.registers && a.accumulator == b.accumulator &&
+           a.pc == b.pc && a.inputPorts == b.inputPorts &&
+           a.outputPorts == b.outputPorts &&
+           a.instructions == b.instructions && a.cycles == b.cycles;
+}
+
+// steps[n] is the state after n instructions.
+static std::vector<Step> walk(const std::vector<uint8_t>& image,
+                              uint8_t bankPort,
+                              uint64_t instructions) {
+    Emulator emulator(image, bankPort);
+    std::vector<Step> steps{{emulator.snapshot(), emulator.state().memory}};
+    while (steps.size() <= instructions &&
+           emulator.run(1) == StopReason::STEP_LIMIT)
+        steps.push_back({emulator.snapshot(), emulator.state().memory});
+    if (steps.size() <= instructions)  // the last step halted
+        steps.push_back({emulator.snapshot(), emulator.state().memory});
+    return steps;
+}
+
+static bool stepsBack(std::string_view name,
+                      const std::vector<uint8_t>& image,
+                      uint8_t bankPort,
+                      uint64_t instructions,
+                      size_t capacity) {
+    std::vector<Step> steps = walk(image, bankPort, instructions);
+    Emulator emulator(image, bankPort);
+    emulator.setJournalCapacity(capacity);
+    emulator.run(instructions);
+    uint64_t executed = emulator.state().instructions;
+    if (!same(emulator.snapshot(), steps[executed].snapshot)) {
+        std::cout << name << ": the journal changes the run.\n";
+        return false;
+    }
+
+    size_t undone = 0;
+    while (emulator.stepBack()) {
+        undone++;
+        const Step& step = steps[executed - undone];
+        if (!same(emulator.snapshot(), step.snapshot) ||
+            emulator.state().memory != step.memory) {
+            std::cout << name << ": state " << undone
+                      << " steps back differs from the run.\n";
+            return false;
+        }
+    }
+    if (undone != std::min<uint64_t>(capacity, executed)) {
+        std::cout << name << ": stepped back " << undone << " of " << executed
+                  << " instructions with room for " << capacity << ".\n";
+        return false;
+    }
+
+    // restore returns to any snapshot, bank included, and empties the
+    // journal.
+    emulator.run(instructions);
+    emulator.restore(steps[1].snapshot);
+    if (!same(emulator.snapshot(), steps[1].snapshot) ||
+        emulator.state().memory != steps[1].memory || emulator.stepBack()) {
+        std::cout << name << ": restore does not return to the snapshot.\n";
+        return false;
+    }
+    return true;
+}
+
+static std::vector<uint8_t> assemble(const std::string& source) {
+    Assembler assembler;
+    std::span<const uint8_t> code = assembler.assemble(source);
+    return {code.begin(), code.end()};
+}
+
+static std::string nops(size_t count) {
+    std::string result;
+    for (size_t i = 0; i < count; i++)
+        result += "NOP\n";
+    return result;
+}
+
+int main() {
+    // examples/labels: a loop that touches registers and the accumulator.
+    std::vector<uint8_t> labels = assemble(R"(MV R3, 05
+MV R4, 00
+MV R1, done
+MV R2, loop
+loop:
+    MV R3
+    JFZ A, R1
+    ADD R4, 02
+    SUB R3, 01
+    JMP R2
+done: HLT
+)");
+    bool ok = stepsBack("labels", labels, Emulator::noBankPort, 30, 16);
+    ok &= stepsBack("labels to the start", labels, Emulator::noBankPort, 30,
+                    64);
+
+    // Bank 0 switches to bank 1 through port 7 at address 3, and bank 1
+    // switches back at address 9; stepping back over either OUT must
+    // bring the old bank back into memory.
+    std::vector<uint8_t> banks =
+        assemble("MV R1, 01\nOUT R1, R7\n" + nops(6) + "INC\nHLT\n");
+    banks.resize(256, 0);
+    std::vector<uint8_t> second =
+        assemble(nops(5) + "INC\nMV R2, 00\nOUT R2, R7\n");
+    banks.insert(banks.end(), second.begin(), second.end());
+    ok &= stepsBack("bank port", banks, 7, 100, 16);
+    return ok ? 0 : 1;
+}